@@ -0,0 +1,124 @@
+#include "DeletionQueue.h"
+
+DeletionQueue::DeletionQueue()
+{
+}
+
+void DeletionQueue::init(VkDevice newDevice)
+{
+	device = newDevice;
+}
+
+void DeletionQueue::destroyBuffer(VkBuffer buffer, uint64_t lastUseValue)
+{
+	Deletion deletion = {};
+	deletion.type = DELETION_BUFFER;
+	deletion.lastUseValue = lastUseValue;
+	deletion.buffer = buffer;
+	push(deletion);
+}
+
+void DeletionQueue::destroyImage(VkImage image, uint64_t lastUseValue)
+{
+	Deletion deletion = {};
+	deletion.type = DELETION_IMAGE;
+	deletion.lastUseValue = lastUseValue;
+	deletion.image = image;
+	push(deletion);
+}
+
+void DeletionQueue::destroyImageView(VkImageView imageView, uint64_t lastUseValue)
+{
+	Deletion deletion = {};
+	deletion.type = DELETION_IMAGE_VIEW;
+	deletion.lastUseValue = lastUseValue;
+	deletion.imageView = imageView;
+	push(deletion);
+}
+
+void DeletionQueue::freeMemory(VkDeviceMemory memory, uint64_t lastUseValue)
+{
+	Deletion deletion = {};
+	deletion.type = DELETION_MEMORY;
+	deletion.lastUseValue = lastUseValue;
+	deletion.memory = memory;
+	push(deletion);
+}
+
+void DeletionQueue::freeDescriptorSet(DescriptorAllocator& allocator, VkDescriptorSet descriptorSet, VkDescriptorSetLayout layout, uint64_t lastUseValue)
+{
+	Deletion deletion = {};
+	deletion.type = DELETION_DESCRIPTOR_SET;
+	deletion.lastUseValue = lastUseValue;
+	deletion.descriptorSet = descriptorSet;
+	deletion.layout = layout;
+	deletion.allocator = &allocator;
+	push(deletion);
+}
+
+uint32_t DeletionQueue::collect(uint64_t completedValue)
+{
+	// values only grow, so everything past the first entry still in use is (almost always) in use as well
+	uint32_t destroyed = 0;
+	while (!deletions.empty() && deletions.front().lastUseValue <= completedValue)
+	{
+		execute(deletions.front());
+		deletions.pop_front();
+		destroyed++;
+	}
+
+	return destroyed;
+}
+
+size_t DeletionQueue::getPendingCount()
+{
+	return deletions.size();
+}
+
+void DeletionQueue::destroy()
+{
+	for (const Deletion& deletion : deletions)
+	{
+		execute(deletion);
+	}
+	deletions.clear();
+}
+
+void DeletionQueue::push(const Deletion& deletion)
+{
+	// a null handle is valid to destroy, but not worth keeping around
+	if (deletion.buffer == VK_NULL_HANDLE && deletion.image == VK_NULL_HANDLE && deletion.imageView == VK_NULL_HANDLE &&
+		deletion.memory == VK_NULL_HANDLE && deletion.descriptorSet == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	deletions.push_back(deletion);
+}
+
+void DeletionQueue::execute(const Deletion& deletion)
+{
+	switch (deletion.type)
+	{
+	case DELETION_BUFFER:
+		vkDestroyBuffer(device, deletion.buffer, nullptr);
+		break;
+
+	case DELETION_IMAGE:
+		vkDestroyImage(device, deletion.image, nullptr);
+		break;
+
+	case DELETION_IMAGE_VIEW:
+		vkDestroyImageView(device, deletion.imageView, nullptr);
+		break;
+
+	case DELETION_MEMORY:
+		// implicitly unmapped if it still was
+		vkFreeMemory(device, deletion.memory, nullptr);
+		break;
+
+	case DELETION_DESCRIPTOR_SET:
+		deletion.allocator->free(deletion.descriptorSet, deletion.layout);
+		break;
+	}
+}
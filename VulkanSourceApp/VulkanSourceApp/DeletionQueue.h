@@ -0,0 +1,64 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <deque>
+
+#include "DescriptorAllocator.h"
+
+// GPU objects waiting for the GPU to be done with them, tagged with the timeline value of the last submission that used them
+// collect() destroys what the completed value has passed, so dropping a resource at runtime never waits for the device
+// entries go in the order they were queued (a view before its image, a buffer before its memory), one tagged with a smaller
+// value than an entry in front of it just waits a little longer
+class DeletionQueue
+{
+public:
+	DeletionQueue();
+
+	void init(VkDevice newDevice);
+
+	// destroyed once the timeline has reached lastUseValue (0 = on the next collect())
+	void destroyBuffer(VkBuffer buffer, uint64_t lastUseValue);
+	void destroyImage(VkImage image, uint64_t lastUseValue);
+	void destroyImageView(VkImageView imageView, uint64_t lastUseValue);
+	void freeMemory(VkDeviceMemory memory, uint64_t lastUseValue);
+	// handed back to allocator for reuse (allocator must outlive the entry)
+	void freeDescriptorSet(DescriptorAllocator& allocator, VkDescriptorSet descriptorSet, VkDescriptorSetLayout layout, uint64_t lastUseValue);
+
+	// destroy every entry up to the first one completedValue hasn't reached, returns the number destroyed
+	uint32_t collect(uint64_t completedValue);
+
+	size_t getPendingCount();
+
+	// destroy everything still queued, the device must be idle
+	void destroy();
+
+private:
+	enum DeletionType {
+		DELETION_BUFFER,
+		DELETION_IMAGE,
+		DELETION_IMAGE_VIEW,
+		DELETION_MEMORY,
+		DELETION_DESCRIPTOR_SET,
+	};
+
+	struct Deletion {
+		DeletionType type;
+		uint64_t lastUseValue;
+		VkBuffer buffer;
+		VkImage image;
+		VkImageView imageView;
+		VkDeviceMemory memory;
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetLayout layout;
+		DescriptorAllocator* allocator;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::deque<Deletion> deletions;
+
+	void push(const Deletion& deletion);
+	void execute(const Deletion& deletion);
+};
@@ -0,0 +1,134 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+DescriptorAllocator::DescriptorAllocator()
+{
+}
+
+void DescriptorAllocator::init(VkDevice newDevice, const std::vector<DescriptorPoolRatio>& newPoolRatios)
+{
+	device = newDevice;
+	poolRatios = newPoolRatios;
+	setsPerPool = DESCRIPTOR_POOL_INITIAL_SETS;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	// recycle a freed set of the same layout first
+	auto freeIt = freeSets.find(layout);
+	if (freeIt != freeSets.end() && !freeIt->second.empty())
+	{
+		VkDescriptorSet descriptorSet = freeIt->second.back();
+		freeIt->second.pop_back();
+		return descriptorSet;
+	}
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = getPool();
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+
+	// current pool is exhausted, retire it and try once more with a new one
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		fullPools.push_back(readyPools.back());
+		readyPools.pop_back();
+
+		setAllocInfo.descriptorPool = getPool();
+		result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate a descriptor set");
+	}
+
+	return descriptorSet;
+}
+
+void DescriptorAllocator::free(VkDescriptorSet descriptorSet, VkDescriptorSetLayout layout)
+{
+	// pools aren't created with FREE_DESCRIPTOR_SET, the set is simply rewritten by whoever gets it next
+	freeSets[layout].push_back(descriptorSet);
+}
+
+void DescriptorAllocator::reset()
+{
+	for (VkDescriptorPool pool : readyPools)
+	{
+		vkResetDescriptorPool(device, pool, 0);
+	}
+	for (VkDescriptorPool pool : fullPools)
+	{
+		vkResetDescriptorPool(device, pool, 0);
+		readyPools.push_back(pool);
+	}
+	fullPools.clear();
+
+	// sets on the free lists came from the pools that were just reset
+	freeSets.clear();
+}
+
+void DescriptorAllocator::destroy()
+{
+	for (VkDescriptorPool pool : readyPools)
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	for (VkDescriptorPool pool : fullPools)
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+	readyPools.clear();
+	fullPools.clear();
+	freeSets.clear();
+}
+
+VkDescriptorPool DescriptorAllocator::getPool()
+{
+	if (!readyPools.empty())
+	{
+		return readyPools.back();
+	}
+
+	VkDescriptorPool pool = createPool(setsPerPool);
+	readyPools.push_back(pool);
+
+	// grow the next pool so large scenes need only a few pools
+	setsPerPool = std::min(setsPerPool * 2, DESCRIPTOR_POOL_MAX_SETS);
+
+	return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount)
+{
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (const DescriptorPoolRatio& poolRatio : poolRatios)
+	{
+		VkDescriptorPoolSize poolSize = {};
+		poolSize.type = poolRatio.type;
+		poolSize.descriptorCount = std::max(1u, static_cast<uint32_t>(poolRatio.ratio * setCount));
+		poolSizes.push_back(poolSize);
+	}
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = setCount;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	VkDescriptorPool pool;
+	VkResult result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &pool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create a descriptor pool");
+	}
+
+	return pool;
+}
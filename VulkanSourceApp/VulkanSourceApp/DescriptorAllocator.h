@@ -0,0 +1,53 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <vector>
+
+// share of a pool's sets each descriptor type gets (ratio 2.0 = 2 descriptors of the type per set)
+struct DescriptorPoolRatio {
+	VkDescriptorType type;
+	float ratio;
+};
+
+// pools are created with this many sets at first, each new pool doubles it up to the max
+const uint32_t DESCRIPTOR_POOL_INITIAL_SETS = 64;
+const uint32_t DESCRIPTOR_POOL_MAX_SETS = 4096;
+
+// hands out descriptor sets from a chain of pools, opening a new pool when the current one runs out
+// (VK_ERROR_OUT_OF_POOL_MEMORY / VK_ERROR_FRAGMENTED_POOL) instead of failing at a fixed limit
+// freed sets are kept per layout and handed out again without touching the pools
+// used as a transient per frame allocator, reset() releases everything at once and keeps the pools for reuse
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator();
+
+	void init(VkDevice newDevice, const std::vector<DescriptorPoolRatio>& newPoolRatios);
+
+	// allocate a set of layout, throws std::runtime_error if even a fresh pool can't hold it
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+	// give a set back for reuse by a later allocate() with the same layout (the set must no longer be in use by the GPU)
+	void free(VkDescriptorSet descriptorSet, VkDescriptorSetLayout layout);
+
+	// reset all pools (invalidating every set allocated from them), the pools stay around for the next allocations
+	void reset();
+
+	void destroy();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<DescriptorPoolRatio> poolRatios;
+	uint32_t setsPerPool = DESCRIPTOR_POOL_INITIAL_SETS;
+
+	std::vector<VkDescriptorPool> readyPools;		// pools that may still have room, last one is allocated from
+	std::vector<VkDescriptorPool> fullPools;		// pools that reported they are out of memory
+
+	std::map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+
+	VkDescriptorPool getPool();
+	VkDescriptorPool createPool(uint32_t setCount);
+};
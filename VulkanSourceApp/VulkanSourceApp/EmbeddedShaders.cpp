@@ -0,0 +1,28 @@
+#include "EmbeddedShaders.h"
+
+// only there after Shaders/compile_shaders.sh has run, without it every shader is read from its .spv file
+#if defined(__has_include)
+#if __has_include("Shaders/Generated/embedded_shaders.h")
+#include "Shaders/Generated/embedded_shaders.h"
+#define HAS_EMBEDDED_SHADERS
+#endif
+#endif
+
+bool findEmbeddedShader(const std::string& fileName, ByteSpan* code)
+{
+#ifdef HAS_EMBEDDED_SHADERS
+	for (const EmbeddedShader& shader : embeddedShaders)
+	{
+		if (fileName == shader.fileName)
+		{
+			*code = ByteSpan(shader.code, shader.size);
+			return true;
+		}
+	}
+#else
+	(void)fileName;
+	(void)code;
+#endif
+
+	return false;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+
+// SPIR-V compiled into the executable, generated by Shaders/compile_shaders.sh
+struct EmbeddedShader {
+	const char* fileName;		// .spv path it stands in for ("Shaders/vert.spv")
+	const uint32_t* code;
+	size_t size;				// in bytes
+};
+
+// embedded code of a .spv path (in the executable's read only data, nothing is copied), returns false if it isn't embedded
+// (headers not generated), then the file has to be read
+bool findEmbeddedShader(const std::string& fileName, ByteSpan* code);
@@ -0,0 +1,126 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "Utilities.h"
+
+// round value up to a multiple of alignment (a power of two, as every Vulkan alignment limit is)
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+FrameAllocator::FrameAllocator()
+{
+}
+
+void FrameAllocator::init(VkPhysicalDevice physicalDevice, DeviceMemoryInfo& memoryInfo, VkDevice newDevice, VkDeviceSize newCapacity)
+{
+	device = newDevice;
+	capacity = newCapacity;
+	used = 0;
+	flushed = 0;
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	uniformAlignment = std::max<VkDeviceSize>(deviceProperties.limits.minUniformBufferOffsetAlignment, 16);
+	storageAlignment = std::max<VkDeviceSize>(deviceProperties.limits.minStorageBufferOffsetAlignment, 16);
+	nonCoherentAtomSize = std::max<VkDeviceSize>(deviceProperties.limits.nonCoherentAtomSize, 1);
+
+	// any host visible memory (the GPU's own where the CPU can write to it), non-coherent writes are flushed by flush()
+	VkMemoryPropertyFlags memoryProperties = createBuffer(memoryInfo, device, capacity,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		&buffer, &memory, BUFFER_MEMORY_DIRECT_WRITE_BIT);
+	coherent = (memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+	// map once and keep it mapped for the lifetime of the buffer
+	void* data;
+	vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data);
+	mapped = static_cast<unsigned char*>(data);
+}
+
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size, FrameAllocationUsage usage)
+{
+	VkDeviceSize alignment = 16;
+	if (usage == FRAME_ALLOCATION_UNIFORM)
+	{
+		alignment = uniformAlignment;
+	}
+	else if (usage == FRAME_ALLOCATION_STORAGE)
+	{
+		alignment = storageAlignment;
+	}
+
+	VkDeviceSize offset = alignUp(used, alignment);
+	if (offset + size > capacity)
+	{
+		throw std::runtime_error("Frame allocator is out of space, increase FRAME_ALLOCATOR_CAPACITY");
+	}
+	used = offset + size;
+
+	FrameAllocation allocation = {};
+	allocation.buffer = buffer;
+	allocation.offset = offset;
+	allocation.data = mapped + offset;
+	return allocation;
+}
+
+void FrameAllocator::flush()
+{
+	if (coherent || used == flushed)
+	{
+		return;
+	}
+
+	// range has to start and end on nonCoherentAtomSize boundaries (or end at the end of the allocation)
+	VkMappedMemoryRange flushRange = {};
+	flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	flushRange.memory = memory;
+	flushRange.offset = flushed & ~(nonCoherentAtomSize - 1);
+	flushRange.size = alignUp(used, nonCoherentAtomSize) >= capacity ? VK_WHOLE_SIZE : alignUp(used, nonCoherentAtomSize) - flushRange.offset;
+	vkFlushMappedMemoryRanges(device, 1, &flushRange);
+
+	flushed = used;
+}
+
+void FrameAllocator::reset()
+{
+	used = 0;
+	flushed = 0;
+}
+
+VkBuffer FrameAllocator::getBuffer()
+{
+	return buffer;
+}
+
+VkDeviceSize FrameAllocator::getUsed()
+{
+	return used;
+}
+
+VkDeviceSize FrameAllocator::getCapacity()
+{
+	return capacity;
+}
+
+void FrameAllocator::destroy()
+{
+	if (buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkUnmapMemory(device, memory);
+	vkDestroyBuffer(device, buffer, nullptr);
+	vkFreeMemory(device, memory, nullptr);
+
+	buffer = VK_NULL_HANDLE;
+	memory = VK_NULL_HANDLE;
+	mapped = nullptr;
+	used = 0;
+	flushed = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Utilities.h"
+
+// bytes of transient data one frame in flight can hand to shaders
+const VkDeviceSize FRAME_ALLOCATOR_CAPACITY = 4 * 1024 * 1024;
+
+// what an allocation is bound as, picks the offset alignment the device requires for it
+enum FrameAllocationUsage {
+	FRAME_ALLOCATION_UNIFORM,		// uniform buffer (minUniformBufferOffsetAlignment)
+	FRAME_ALLOCATION_STORAGE,		// storage buffer (minStorageBufferOffsetAlignment)
+	FRAME_ALLOCATION_VERTEX,		// vertex or index data (no alignment beyond 16 bytes)
+};
+
+// a piece of the frame's buffer, write through data and bind buffer at offset
+struct FrameAllocation {
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	void* data;
+};
+
+// linear allocator over one persistently mapped host visible buffer, one per frame in flight
+// allocate() only bumps an offset, reset() starts over (once the frame's last submission is done on the GPU)
+// non-coherent memory is flushed in one range per frame by flush(), before the frame is submitted
+class FrameAllocator
+{
+public:
+	FrameAllocator();
+
+	void init(VkPhysicalDevice physicalDevice, DeviceMemoryInfo& memoryInfo, VkDevice newDevice, VkDeviceSize newCapacity);
+
+	// size bytes aligned for usage, throws std::runtime_error if the frame's space ran out
+	FrameAllocation allocate(VkDeviceSize size, FrameAllocationUsage usage);
+
+	// make everything allocated since reset() visible to the GPU (nothing to do on coherent memory)
+	void flush();
+
+	// drop every allocation, the GPU must be done with them
+	void reset();
+
+	VkBuffer getBuffer();
+	VkDeviceSize getUsed();
+	VkDeviceSize getCapacity();
+
+	void destroy();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	unsigned char* mapped = nullptr;
+
+	VkDeviceSize capacity = 0;
+	VkDeviceSize used = 0;
+	VkDeviceSize flushed = 0;					// end of the range flush() already covered
+
+	VkDeviceSize uniformAlignment = 1;
+	VkDeviceSize storageAlignment = 1;
+	VkDeviceSize nonCoherentAtomSize = 1;
+	bool coherent = true;
+};
@@ -0,0 +1,80 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+#include "FrameLimiter.h"
+
+#include <thread>
+
+// remaining time that is spun instead of slept
+static const std::chrono::microseconds FRAME_LIMITER_SPIN_TIME(1500);
+
+FrameLimiter::FrameLimiter()
+{
+}
+
+void FrameLimiter::setTargetFrameRate(double framesPerSecond)
+{
+	if (framesPerSecond <= 0.0)
+	{
+		framePeriod = Clock::duration::zero();
+		return;
+	}
+
+	framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+
+	// default Windows sleep granularity is ~15.6 ms, which is most of a frame
+#ifdef _WIN32
+	if (!highResolutionTimer)
+	{
+		highResolutionTimer = timeBeginPeriod(1) == TIMERR_NOERROR;
+	}
+#endif
+}
+
+void FrameLimiter::wait()
+{
+	if (framePeriod == Clock::duration::zero())
+	{
+		return;
+	}
+
+	Clock::time_point now = Clock::now();
+
+	// more than a frame behind (first frame, a long frame, a breakpoint), start counting from now instead of catching up with a burst of frames
+	if (now - nextFrame > framePeriod)
+	{
+		nextFrame = now;
+	}
+
+	// sleep most of the way
+	while (nextFrame - now > FRAME_LIMITER_SPIN_TIME)
+	{
+		std::this_thread::sleep_for(nextFrame - now - FRAME_LIMITER_SPIN_TIME);
+		now = Clock::now();
+	}
+
+	// spin the rest
+	while (now < nextFrame)
+	{
+		std::this_thread::yield();
+		now = Clock::now();
+	}
+
+	// deadlines advance by whole periods, so an early or late wake up doesn't drift the frame rate
+	nextFrame += framePeriod;
+}
+
+FrameLimiter::~FrameLimiter()
+{
+#ifdef _WIN32
+	if (highResolutionTimer)
+	{
+		timeEndPeriod(1);
+	}
+#endif
+}
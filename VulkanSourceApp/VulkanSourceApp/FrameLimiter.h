@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+
+// caps the frame rate of a loop by sleeping at the top of each iteration, before input is sampled
+// (sleeping after drawing would leave the input of the next frame as old as the sleep)
+// sleeps coarsely until shortly before the deadline, then spins the rest, since OS sleeps can overshoot by a millisecond or more
+class FrameLimiter
+{
+public:
+	FrameLimiter();
+
+	// frames per second to cap at, 0 = unlimited
+	void setTargetFrameRate(double framesPerSecond);
+
+	// block until the next frame may start, call first thing in the frame
+	void wait();
+
+	~FrameLimiter();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::duration framePeriod = Clock::duration::zero();
+	Clock::time_point nextFrame;
+	bool highResolutionTimer = false;		// Windows timer period lowered to 1 ms
+};
@@ -0,0 +1,312 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+// which pool the current thread works for, so jobs queued from a job go to the worker's own queue
+static thread_local const JobSystem* currentJobSystem = nullptr;
+static thread_local uint32_t currentWorker = 0;
+
+const uint32_t NO_WORKER = UINT32_MAX;
+
+JobSystem::JobSystem()
+{
+}
+
+void JobSystem::init(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	stopping = false;
+	queuedJobs = 0;
+
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(new Worker());
+	}
+
+	// only started once every queue exists, workers steal from all of them
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		threads.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+void JobSystem::run(std::function<void()> job, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// single core machine, nobody else would run it
+	if (workers.empty())
+	{
+		Job inlineJob = { std::move(job), counter };
+		execute(inlineJob, externalStats);
+		return;
+	}
+
+	// a job's own jobs stay on its worker, they likely touch the same data
+	uint32_t workerIndex = currentWorkerIndex();
+	if (workerIndex == NO_WORKER)
+	{
+		workerIndex = nextWorker.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32_t>(workers.size());
+	}
+
+	// counted first, so it never drops below the number of jobs actually queued
+	queuedJobs.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(workers[workerIndex]->mutex);
+		workers[workerIndex]->jobs.push_back({ std::move(job), counter });
+	}
+
+	// taking the lock orders this with a worker checking queuedJobs before it sleeps, no wakeup gets lost
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	sleepCondition.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	uint32_t workerIndex = currentWorkerIndex();
+	JobStats& stats = workerIndex == NO_WORKER ? externalStats : workers[workerIndex]->stats;
+
+	// help instead of blocking, the jobs waited for may be sitting in a queue
+	while (counter.pending.load(std::memory_order_acquire) > 0)
+	{
+		Job job;
+		if (findJob(workerIndex, stats, &job))
+		{
+			execute(job, stats);
+		}
+		else
+		{
+			// the last jobs are running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	batchSize = std::max<size_t>(batchSize, 1);
+	size_t batchCount = (count + batchSize - 1) / batchSize;
+	if (batchCount == 1 || workers.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto runBatch = [&](size_t batch) {
+		try {
+			body(batch * batchSize, std::min(count, (batch + 1) * batchSize));
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	};
+
+	for (size_t batch = 1; batch < batchCount; batch++)
+	{
+		run([&runBatch, batch]() { runBatch(batch); }, &counter);
+	}
+
+	// calling thread works too, then helps with the rest (every job references this frame)
+	runBatch(0);
+	wait(counter);
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+uint32_t JobSystem::getWorkerCount()
+{
+	return static_cast<uint32_t>(workers.size());
+}
+
+JobSystemStats JobSystem::getStats()
+{
+	JobSystemStats result = {};
+	uint64_t idleNanoseconds = 0;
+
+	auto add = [&](const JobStats& stats) {
+		result.jobsRun += stats.jobsRun.load(std::memory_order_relaxed);
+		result.steals += stats.steals.load(std::memory_order_relaxed);
+		result.stealAttempts += stats.stealAttempts.load(std::memory_order_relaxed);
+		idleNanoseconds += stats.idleNanoseconds.load(std::memory_order_relaxed);
+	};
+
+	for (const std::unique_ptr<Worker>& worker : workers)
+	{
+		add(worker->stats);
+	}
+	add(externalStats);
+
+	result.idleSeconds = idleNanoseconds / 1e9;
+	return result;
+}
+
+void JobSystem::resetStats()
+{
+	auto reset = [](JobStats& stats) {
+		stats.jobsRun = 0;
+		stats.steals = 0;
+		stats.stealAttempts = 0;
+		stats.idleNanoseconds = 0;
+	};
+
+	for (std::unique_ptr<Worker>& worker : workers)
+	{
+		reset(worker->stats);
+	}
+	reset(externalStats);
+}
+
+void JobSystem::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	sleepCondition.notify_all();
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	threads.clear();
+	workers.clear();
+}
+
+uint32_t JobSystem::currentWorkerIndex()
+{
+	return currentJobSystem == this ? currentWorker : NO_WORKER;
+}
+
+bool JobSystem::popJob(uint32_t workerIndex, Job* job)
+{
+	Worker& worker = *workers[workerIndex];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.jobs.empty())
+	{
+		return false;
+	}
+
+	// newest first
+	*job = std::move(worker.jobs.back());
+	worker.jobs.pop_back();
+	queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobSystem::stealJob(uint32_t firstVictim, uint32_t thiefIndex, JobStats& stats, Job* job)
+{
+	uint32_t workerCount = static_cast<uint32_t>(workers.size());
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		uint32_t victimIndex = (firstVictim + i) % workerCount;
+		if (victimIndex == thiefIndex)
+		{
+			continue;
+		}
+
+		stats.stealAttempts.fetch_add(1, std::memory_order_relaxed);
+
+		Worker& victim = *workers[victimIndex];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.jobs.empty())
+		{
+			continue;
+		}
+
+		// oldest first, the owner is busy with the newer ones
+		*job = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		stats.steals.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	return false;
+}
+
+bool JobSystem::findJob(uint32_t workerIndex, JobStats& stats, Job* job)
+{
+	if (workers.empty() || queuedJobs.load(std::memory_order_acquire) == 0)
+	{
+		return false;
+	}
+
+	if (workerIndex != NO_WORKER)
+	{
+		return popJob(workerIndex, job) || stealJob(workerIndex + 1, workerIndex, stats, job);
+	}
+
+	// threads outside the pool have no queue of their own, start at a different worker each time
+	return stealJob(nextWorker.load(std::memory_order_relaxed), NO_WORKER, stats, job);
+}
+
+void JobSystem::execute(Job& job, JobStats& stats)
+{
+	job.function();
+	stats.jobsRun.fetch_add(1, std::memory_order_relaxed);
+
+	// last thing touching the job, a waiter may return (and free what the job referenced) right after
+	if (job.counter)
+	{
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex)
+{
+	currentJobSystem = this;
+	currentWorker = workerIndex;
+
+	Worker& worker = *workers[workerIndex];
+
+	while (true)
+	{
+		Job job;
+		if (findJob(workerIndex, worker.stats, &job))
+		{
+			execute(job, worker.stats);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		if (queuedJobs.load(std::memory_order_acquire) > 0)
+		{
+			continue;		// queued while we were looking
+		}
+		if (stopping)
+		{
+			break;
+		}
+
+		std::chrono::steady_clock::time_point sleepStart = std::chrono::steady_clock::now();
+		sleepCondition.wait(lock, [this] { return queuedJobs.load(std::memory_order_acquire) > 0 || stopping; });
+		worker.stats.idleNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sleepStart).count(), std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of unfinished jobs, run() adds one and the job takes it away again once it ran
+// work that depends on other jobs waits on their counter first (wait() runs other jobs in the meantime)
+struct JobCounter {
+	std::atomic<uint32_t> pending{ 0 };
+};
+
+// totals since the last resetStats(), summed over all threads that ran jobs
+struct JobSystemStats {
+	uint64_t jobsRun;			// jobs finished, by workers and by threads helping out in wait()
+	uint64_t steals;			// jobs taken from another worker's queue
+	uint64_t stealAttempts;		// other queues looked into for work, successful or not
+	double idleSeconds;			// time workers slept because there was no work anywhere
+};
+
+// work stealing scheduler, one job queue per worker thread
+// a worker runs the newest job of its own queue first (still warm in its cache) and takes the oldest job of
+// another worker's queue once its own is empty, it only goes to sleep when there's nothing left anywhere
+// jobs can be queued from any thread, threads outside the pool spread their jobs over the workers' queues
+// jobs must not throw (parallelFor() catches for its body)
+class JobSystem
+{
+public:
+	JobSystem();
+
+	// workerCount 0 : one worker per core, apart from the calling thread's (which helps in wait())
+	void init(uint32_t workerCount = 0);
+
+	// queue job, counter (optional) is increased right away and decreased once the job ran
+	// without workers the job runs right here
+	void run(std::function<void()> job, JobCounter* counter = nullptr);
+
+	// run queued jobs on this thread until counter reaches 0
+	void wait(JobCounter& counter);
+
+	// body(begin, end) for ranges of batchSize over [0, count), the calling thread takes the first range
+	// returns once all ranges ran, rethrows the first exception body threw
+	void parallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& body);
+
+	uint32_t getWorkerCount();
+	JobSystemStats getStats();
+	void resetStats();
+
+	// run what's still queued and join the workers
+	void destroy();
+
+private:
+	struct Job {
+		std::function<void()> function;
+		JobCounter* counter;
+	};
+
+	struct JobStats {
+		std::atomic<uint64_t> jobsRun{ 0 };
+		std::atomic<uint64_t> steals{ 0 };
+		std::atomic<uint64_t> stealAttempts{ 0 };
+		std::atomic<uint64_t> idleNanoseconds{ 0 };
+	};
+
+	// the owner pushes and pops at the back, thieves take from the front
+	struct Worker {
+		std::deque<Job> jobs;
+		std::mutex mutex;
+		JobStats stats;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+	JobStats externalStats;							// jobs run by threads outside the pool while they wait()
+	std::atomic<uint32_t> nextWorker{ 0 };			// round robin queue for jobs from outside the pool
+	std::atomic<uint32_t> queuedJobs{ 0 };
+
+	// idle workers
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool stopping = false;
+
+	uint32_t currentWorkerIndex();
+	bool popJob(uint32_t workerIndex, Job* job);
+	bool stealJob(uint32_t firstVictim, uint32_t thiefIndex, JobStats& stats, Job* job);
+	bool findJob(uint32_t workerIndex, JobStats& stats, Job* job);
+	void execute(Job& job, JobStats& stats);
+	void workerLoop(uint32_t workerIndex);
+};
@@ -0,0 +1,324 @@
+#include "Json.h"
+
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+
+const JsonValue* JsonValue::find(const char* key) const
+{
+	if (type != JSON_OBJECT)
+	{
+		return nullptr;
+	}
+
+	for (const auto& member : object)
+	{
+		if (member.first == key)
+		{
+			return &member.second;
+		}
+	}
+
+	return nullptr;
+}
+
+double JsonValue::getNumber(const char* key, double fallback) const
+{
+	const JsonValue* value = find(key);
+	return value && value->type == JSON_NUMBER ? value->number : fallback;
+}
+
+int JsonValue::getInt(const char* key, int fallback) const
+{
+	const JsonValue* value = find(key);
+	return value && value->type == JSON_NUMBER ? static_cast<int>(value->number) : fallback;
+}
+
+bool JsonValue::getBool(const char* key, bool fallback) const
+{
+	const JsonValue* value = find(key);
+	return value && value->type == JSON_BOOL ? value->boolean : fallback;
+}
+
+std::string JsonValue::getString(const char* key, const std::string& fallback) const
+{
+	const JsonValue* value = find(key);
+	return value && value->type == JSON_STRING ? value->string : fallback;
+}
+
+size_t JsonValue::size() const
+{
+	return type == JSON_ARRAY ? array.size() : 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t i) const
+{
+	if (type != JSON_ARRAY || i >= array.size())
+	{
+		throw std::runtime_error("JSON array index out of range");
+	}
+
+	return array[i];
+}
+
+// recursive descent parser over the raw text
+struct JsonParser {
+	const char* current;
+	const char* end;
+
+	void skipWhitespace()
+	{
+		while (current < end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+		{
+			current++;
+		}
+	}
+
+	void expect(char c)
+	{
+		skipWhitespace();
+		if (current >= end || *current != c)
+		{
+			throw std::runtime_error(std::string("Malformed JSON, expected '") + c + "'");
+		}
+		current++;
+	}
+
+	bool matchLiteral(const char* literal)
+	{
+		const char* c = current;
+		for (; *literal; literal++, c++)
+		{
+			if (c >= end || *c != *literal)
+			{
+				return false;
+			}
+		}
+		current = c;
+		return true;
+	}
+
+	static void appendUtf8(std::string& out, uint32_t codePoint)
+	{
+		if (codePoint < 0x80)
+		{
+			out += char(codePoint);
+		}
+		else if (codePoint < 0x800)
+		{
+			out += char(0xC0 | (codePoint >> 6));
+			out += char(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			out += char(0xE0 | (codePoint >> 12));
+			out += char(0x80 | ((codePoint >> 6) & 0x3F));
+			out += char(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			out += char(0xF0 | (codePoint >> 18));
+			out += char(0x80 | ((codePoint >> 12) & 0x3F));
+			out += char(0x80 | ((codePoint >> 6) & 0x3F));
+			out += char(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	uint32_t parseHex4()
+	{
+		if (end - current < 4)
+		{
+			throw std::runtime_error("Malformed JSON, truncated \\u escape");
+		}
+
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			char c = *current++;
+			value <<= 4;
+			if (c >= '0' && c <= '9') value |= c - '0';
+			else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+			else throw std::runtime_error("Malformed JSON, bad \\u escape");
+		}
+		return value;
+	}
+
+	std::string parseString()
+	{
+		expect('"');
+
+		std::string result;
+		while (true)
+		{
+			if (current >= end)
+			{
+				throw std::runtime_error("Malformed JSON, unterminated string");
+			}
+
+			char c = *current++;
+			if (c == '"')
+			{
+				break;
+			}
+
+			if (c != '\\')
+			{
+				result += c;
+				continue;
+			}
+
+			if (current >= end)
+			{
+				throw std::runtime_error("Malformed JSON, unterminated string");
+			}
+
+			char escape = *current++;
+			switch (escape)
+			{
+			case '"': result += '"'; break;
+			case '\\': result += '\\'; break;
+			case '/': result += '/'; break;
+			case 'b': result += '\b'; break;
+			case 'f': result += '\f'; break;
+			case 'n': result += '\n'; break;
+			case 'r': result += '\r'; break;
+			case 't': result += '\t'; break;
+			case 'u':
+			{
+				uint32_t codePoint = parseHex4();
+
+				// surrogate pair for code points above the BMP
+				if (codePoint >= 0xD800 && codePoint < 0xDC00 && end - current >= 6 && current[0] == '\\' && current[1] == 'u')
+				{
+					current += 2;
+					uint32_t low = parseHex4();
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUtf8(result, codePoint);
+				break;
+			}
+			default:
+				throw std::runtime_error("Malformed JSON, unknown escape");
+			}
+		}
+
+		return result;
+	}
+
+	JsonValue parseValue()
+	{
+		skipWhitespace();
+		if (current >= end)
+		{
+			throw std::runtime_error("Malformed JSON, unexpected end");
+		}
+
+		JsonValue value;
+		char c = *current;
+
+		if (c == '{')
+		{
+			value.type = JsonValue::JSON_OBJECT;
+			current++;
+			skipWhitespace();
+			if (current < end && *current == '}')
+			{
+				current++;
+				return value;
+			}
+
+			while (true)
+			{
+				std::string key = parseString();
+				expect(':');
+				value.object.emplace_back(std::move(key), parseValue());
+
+				skipWhitespace();
+				if (current < end && *current == ',')
+				{
+					current++;
+					continue;
+				}
+				expect('}');
+				break;
+			}
+		}
+		else if (c == '[')
+		{
+			value.type = JsonValue::JSON_ARRAY;
+			current++;
+			skipWhitespace();
+			if (current < end && *current == ']')
+			{
+				current++;
+				return value;
+			}
+
+			while (true)
+			{
+				value.array.push_back(parseValue());
+
+				skipWhitespace();
+				if (current < end && *current == ',')
+				{
+					current++;
+					continue;
+				}
+				expect(']');
+				break;
+			}
+		}
+		else if (c == '"')
+		{
+			value.type = JsonValue::JSON_STRING;
+			value.string = parseString();
+		}
+		else if (matchLiteral("true"))
+		{
+			value.type = JsonValue::JSON_BOOL;
+			value.boolean = true;
+		}
+		else if (matchLiteral("false"))
+		{
+			value.type = JsonValue::JSON_BOOL;
+			value.boolean = false;
+		}
+		else if (matchLiteral("null"))
+		{
+			value.type = JsonValue::JSON_NULL;
+		}
+		else
+		{
+			// strtod needs a terminated string, numbers are short so copy them out
+			const char* start = current;
+			while (current < end && (*current == '-' || *current == '+' || *current == '.' || *current == 'e' || *current == 'E' || (*current >= '0' && *current <= '9')))
+			{
+				current++;
+			}
+			if (current == start)
+			{
+				throw std::runtime_error("Malformed JSON, unexpected character");
+			}
+
+			value.type = JsonValue::JSON_NUMBER;
+			value.number = strtod(std::string(start, current).c_str(), nullptr);
+		}
+
+		return value;
+	}
+};
+
+JsonValue parseJson(const char* text, size_t length)
+{
+	JsonParser parser = { text, text + length };
+	JsonValue root = parser.parseValue();
+
+	parser.skipWhitespace();
+	if (parser.current != parser.end)
+	{
+		throw std::runtime_error("Malformed JSON, trailing data");
+	}
+
+	return root;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// minimal JSON document (enough for glTF), objects keep their members in file order
+struct JsonValue {
+	enum Type {
+		JSON_NULL,
+		JSON_BOOL,
+		JSON_NUMBER,
+		JSON_STRING,
+		JSON_ARRAY,
+		JSON_OBJECT
+	};
+
+	Type type = JSON_NULL;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	// member lookup, returns nullptr if this isn't an object or the key doesn't exist
+	const JsonValue* find(const char* key) const;
+
+	// typed lookups with a fallback for missing members
+	double getNumber(const char* key, double fallback = 0.0) const;
+	int getInt(const char* key, int fallback = -1) const;
+	bool getBool(const char* key, bool fallback = false) const;
+	std::string getString(const char* key, const std::string& fallback = "") const;
+
+	size_t size() const;
+	const JsonValue& operator[](size_t i) const;
+};
+
+// parse a UTF-8 JSON text, throws std::runtime_error on malformed input
+JsonValue parseJson(const char* text, size_t length);
@@ -0,0 +1,152 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		mapping = other.mapping;
+		mappingSize = other.mappingSize;
+		opened = other.opened;
+		other.mapping = nullptr;
+		other.mappingSize = 0;
+		other.opened = false;
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string& fileName)
+{
+	close();
+
+#ifdef _WIN32
+	// sequential scan makes the cache manager read ahead further and drop pages behind the reader sooner
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || static_cast<unsigned long long>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// a zero length file can't be mapped, but there's nothing to read anyway
+	if (fileSize.QuadPart > 0)
+	{
+		HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (fileMapping)
+		{
+			mapping = static_cast<const char*>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(fileMapping);		// the view keeps the mapping (and the file) alive
+		}
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+		mappingSize = static_cast<size_t>(fileSize.QuadPart);
+
+		// fault the whole view in with a few large reads instead of one page fault at a time (Windows 8 and later)
+#if _WIN32_WINNT >= 0x0602
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = const_cast<char*>(mapping);
+		range.NumberOfBytes = mappingSize;
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+	}
+	CloseHandle(file);
+#else
+	int file = ::open(fileName.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0)
+	{
+		::close(file);
+		return false;
+	}
+
+	// a zero length file can't be mapped, but there's nothing to read anyway
+	if (fileStat.st_size > 0)
+	{
+		void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (view == MAP_FAILED)
+		{
+			::close(file);
+			return false;
+		}
+		mapping = static_cast<const char*>(view);
+		mappingSize = static_cast<size_t>(fileStat.st_size);
+
+		// read front to back, and soon: read ahead starts now and is more aggressive, read pages can be dropped early
+		madvise(view, mappingSize, MADV_SEQUENTIAL);
+		madvise(view, mappingSize, MADV_WILLNEED);
+	}
+	::close(file);		// the mapping stays valid without the descriptor
+#endif
+
+	opened = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapping)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mapping);
+#else
+		munmap(const_cast<char*>(mapping), mappingSize);
+#endif
+	}
+
+	mapping = nullptr;
+	mappingSize = 0;
+	opened = false;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile mapFile(const std::string& fileName)
+{
+	MappedFile file;
+	if (!file.open(fileName))
+	{
+		throw std::runtime_error("Failed to open a file! (" + fileName + ")");
+	}
+	return file;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// bytes owned by someone else (a mapped file, code compiled into the executable), only valid as long as the owner is
+class ByteSpan
+{
+public:
+	ByteSpan() {}
+	ByteSpan(const void* newData, size_t newSize) : bytes(static_cast<const char*>(newData)), byteCount(newSize) {}
+
+	const char* data() const { return bytes; }
+	size_t size() const { return byteCount; }
+	bool empty() const { return byteCount == 0; }
+
+private:
+	const char* bytes = nullptr;
+	size_t byteCount = 0;
+};
+
+// whole file mapped read only, so it is read straight from the page cache instead of being copied onto the heap first
+// the OS is told it will be read front to back soon (read ahead starts right away, pages behind the reader can go early)
+// move-only, unmapped by the destructor, spans of it must not outlive it
+class MappedFile
+{
+public:
+	MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// returns false if the file can't be opened or mapped, an empty file opens fine (with no data)
+	bool open(const std::string& fileName);
+	void close();
+
+	bool isOpen() const { return opened; }
+	const char* data() const { return mapping; }
+	size_t size() const { return mappingSize; }
+	ByteSpan span() const { return ByteSpan(mapping, mappingSize); }
+
+	~MappedFile();
+
+private:
+	const char* mapping = nullptr;
+	size_t mappingSize = 0;
+	bool opened = false;
+};
+
+// map a file, throws std::runtime_error if it can't be opened
+MappedFile mapFile(const std::string& fileName);
@@ -1,55 +1,154 @@
 #include "Mesh.h"
 
-Mesh::Mesh()
+static void createVertexBuffer(MeshBuffers& buffers, DeviceMemoryInfo& memoryInfo, UploadBatch& uploadBatch, std::vector<Vertex>* vertices)
 {
+	// get size of buffer needed for vertices
+	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
+
+	// create buffer with TRANSFER_DST_BIT to mark as recipient of transfer data (also VERTEX_BUFFER)
+	// buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the GPU, where the CPU can write to that memory too
+	// (integrated GPUs, resizable BAR) it's written in place, no staging copy or transfer
+	VkMemoryPropertyFlags memoryProperties = createBuffer(memoryInfo, buffers.device, bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		buffers.vertexBuffer.put(), buffers.vertexBufferMemory.put(), BUFFER_MEMORY_DIRECT_WRITE_BIT);
+
+	if (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		writeMemory(buffers.device, buffers.vertexBufferMemory.get(), vertices->data(), bufferSize);
+	}
+	else
+	{
+		// data is copied into the batch's staging memory now, the copy to the GPU runs when the batch is submitted
+		uploadBatch.uploadBuffer(vertices->data(), bufferSize, buffers.vertexBuffer.get());
+	}
 }
 
-Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int newTexId)
+static void createIndexBuffer(MeshBuffers& buffers, DeviceMemoryInfo& memoryInfo, UploadBatch& uploadBatch, std::vector<uint32_t>* indices)
 {
-	vertexCount = vertices->size();
-	indexCount = indices->size();
-	physicalDevice = newPhysicalDevice;
-	device = newDevice;
-	createVertexBuffer(transferQueue, transferCommandPool, vertices);
-	createIndexBuffer(transferQueue, transferCommandPool, indices);
-
-	model.model = glm::mat4(1.0f);
-	texId = newTexId;
+	// get size of buffer needed for indices
+	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
+
+	// create buffer for INDEX data on GPU memory, written in place if the CPU can reach it
+	VkMemoryPropertyFlags memoryProperties = createBuffer(memoryInfo, buffers.device, bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		buffers.indexBuffer.put(), buffers.indexBufferMemory.put(), BUFFER_MEMORY_DIRECT_WRITE_BIT);
+
+	if (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		writeMemory(buffers.device, buffers.indexBufferMemory.get(), indices->data(), bufferSize);
+	}
+	else
+	{
+		// copy from staging memory to GPU access buffer when the batch is submitted
+		uploadBatch.uploadBuffer(indices->data(), bufferSize, buffers.indexBuffer.get());
+	}
 }
 
-void Mesh::setModel(glm::mat4 newModel)
+static void calculateBounds(MeshBuffers& buffers, std::vector<Vertex>* vertices)
 {
-	model.model = newModel;
+	// sphere around the center of the bounding box (not minimal, but cheap and good enough for LOD distances)
+	glm::vec3 minPos = vertices->empty() ? glm::vec3(0.0f) : (*vertices)[0].pos;
+	glm::vec3 maxPos = minPos;
+	for (const Vertex& vertex : *vertices)
+	{
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+
+	buffers.boundsCenter = (minPos + maxPos) * 0.5f;
+	buffers.boundsRadius = 0.0f;
+	for (const Vertex& vertex : *vertices)
+	{
+		buffers.boundsRadius = std::max(buffers.boundsRadius, glm::length(vertex.pos - buffers.boundsCenter));
+	}
 }
 
-Model Mesh::getModel()
+MeshBuffers createMeshBuffers(DeviceMemoryInfo& memoryInfo, VkDevice device, UploadBatch& uploadBatch, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
+	MeshCreateFlags createFlags, MeshOptimizationStatistics* optimizationStatistics)
 {
-	return model;
+	MeshBuffers buffers;
+	buffers.device = device;
+
+	// optional preprocessing works on a copy, the caller's data stays untouched
+	std::vector<Vertex> processedVertices;
+	std::vector<uint32_t> processedIndices;
+	if (createFlags & (MESH_CREATE_OPTIMIZE_BIT | MESH_CREATE_GENERATE_LODS_BIT))
+	{
+		processedVertices = *vertices;
+		processedIndices = *indices;
+		vertices = &processedVertices;
+		indices = &processedIndices;
+	}
+
+	// reorder for vertex cache, overdraw and vertex fetch before upload
+	if (createFlags & MESH_CREATE_OPTIMIZE_BIT)
+	{
+		MeshOptimizationStatistics statistics = optimizeMesh(processedVertices, processedIndices);
+		if (optimizationStatistics)
+		{
+			*optimizationStatistics = statistics;
+		}
+	}
+
+	// simplified LODs are appended to the index buffer, otherwise the full mesh is the only LOD
+	if (createFlags & MESH_CREATE_GENERATE_LODS_BIT)
+	{
+		buffers.lods = generateLodChain(processedVertices, processedIndices);
+	}
+	else
+	{
+		buffers.lods.push_back({ 0, static_cast<uint32_t>(indices->size()), 0.0f });
+	}
+
+	calculateBounds(buffers, vertices);
+
+	createVertexBuffer(buffers, memoryInfo, uploadBatch, vertices);
+	createIndexBuffer(buffers, memoryInfo, uploadBatch, indices);
+
+	return buffers;
 }
 
-Model* Mesh::getModelRef()
+void MeshBuffers::destroy(DeletionQueue& deletionQueue, uint64_t lastUseValue)
 {
-	return &model;
+	deletionQueue.destroyBuffer(vertexBuffer.release(), lastUseValue);
+	deletionQueue.freeMemory(vertexBufferMemory.release(), lastUseValue);
+	deletionQueue.destroyBuffer(indexBuffer.release(), lastUseValue);
+	deletionQueue.freeMemory(indexBufferMemory.release(), lastUseValue);
 }
 
-int Mesh::getTexId()
+MeshBuffers::~MeshBuffers()
 {
-	return texId;
+	// only what was never handed to the deletion queue, each buffer before its memory
+	vertexBuffer.reset(device);
+	vertexBufferMemory.reset(device);
+	indexBuffer.reset(device);
+	indexBufferMemory.reset(device);
 }
 
-int Mesh::getVertexCount()
+Mesh::Mesh()
 {
-	return vertexCount;
 }
 
-VkBuffer Mesh::getVertexBuffer()
+Mesh::Mesh(const MeshBuffers& buffers, TextureHandle newTexId)
 {
-	return vertexBuffer;
+	vertexBuffer = buffers.vertexBuffer.get();
+	indexBuffer = buffers.indexBuffer.get();
+	lods = &buffers.lods;
+	boundsCenter = buffers.boundsCenter;
+	boundsRadius = buffers.boundsRadius;
+	texId = newTexId;
+}
+
+TextureHandle Mesh::getTexId()
+{
+	return texId;
 }
 
-int Mesh::getIndexCount()
+VkBuffer Mesh::getVertexBuffer()
 {
-	return indexCount;
+	return vertexBuffer;
 }
 
 VkBuffer Mesh::getIndexBuffer()
@@ -57,83 +156,22 @@ VkBuffer Mesh::getIndexBuffer()
 	return indexBuffer;
 }
 
-void Mesh::destroyBuffers()
+int Mesh::getLodCount()
 {
-	vkDestroyBuffer(device, vertexBuffer, nullptr);
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
-	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
+	return static_cast<int>(lods->size());
 }
 
-Mesh::~Mesh()
+const MeshLod& Mesh::getLod(int lod)
 {
+	return (*lods)[lod];
 }
 
-void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices)
+glm::vec3 Mesh::getBoundsCenter()
 {
-	// get size of buffer needed for vertices
-	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
-
-	// temporary buffer to "stage" vertex data before transferring to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	// create Staging buffer and allocate memory to it
-	createBuffer(physicalDevice, device, bufferSize, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&stagingBuffer, &stagingBufferMemory);
-
-	// map memory to staging buffer
-	void* data;																										// 1. create pointer to a Point in normal memory
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);			// 2. map the vertex buffer memory to that Point
-	memcpy(data, vertices->data(), (size_t)bufferSize);											// 3. copy memory from vertices vector to the Point
-	vkUnmapMemory(device, stagingBufferMemory);											// 4. unmap the vertex buffer memory
-
-	// create buffer with TRANSFER_DST_BIT to mark as recipient of transfer data (also VERTEX_BUFFER)
-	// buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the GPU and only accessible by it and not CPU (host)
-	createBuffer(physicalDevice, device, bufferSize, 
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&vertexBuffer, &vertexBufferMemory);
-
-	// copy staging buffer to vertex buffer on GPU
-	copyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, vertexBuffer, bufferSize);
-
-	// clean up staging buffer parts
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	return boundsCenter;
 }
 
-void Mesh::createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices)
+float Mesh::getBoundsRadius()
 {
-	// get size of buffer needed for indices
-	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
-
-	// temprorary buffer to "stage" vertex data before transferring to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(physicalDevice, device, bufferSize, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-		&stagingBuffer, &stagingBufferMemory);
-
-	// map memory to staging buffer
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices->data(), (size_t)bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
-
-	// create buffer for INDEX data on GPU access only area
-	createBuffer(physicalDevice, device, bufferSize, 
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&indexBuffer, &indexBufferMemory);
-
-	// copy from staging buffer to GPU access buffer
-	copyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, indexBuffer, bufferSize);
-
-	// Destroy + release staging buffer resources
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	return boundsRadius;
 }
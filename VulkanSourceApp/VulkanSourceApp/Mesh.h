@@ -6,50 +6,86 @@
 #include <vector>
 
 #include "Utilities.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "DeletionQueue.h"
+#include "VulkanHandle.h"
+#include "UploadBatch.h"
+
+// optional processing of the vertex/index data before it is uploaded
+enum MeshCreateFlagBits {
+	MESH_CREATE_OPTIMIZE_BIT = 0x00000001,			// reorder for vertex cache, overdraw and vertex fetch
+	MESH_CREATE_GENERATE_LODS_BIT = 0x00000002,	// build a chain of simplified LODs in the index buffer
+};
+typedef uint32_t MeshCreateFlags;
 
+// per-object data pushed to the vertex shader (model matrices themselves are owned by the renderer)
 struct Model {
 	glm::mat4 model;
 };
 
+// vertex and index buffers of a mesh with what was built along with them (LODs, bounds, optimization statistics)
+// one set is shared by every instance of the mesh and owned by the renderer, move-only so it's never copied by accident
+// dropped while it still owns buffers (e.g. loading threw before they were handed over) it destroys them at once,
+// destroy() queues them until the GPU is done with them instead
+struct MeshBuffers {
+	VkDevice device = VK_NULL_HANDLE;		// the buffers were created on, kept once for all of them
+
+	UniqueDeviceMemory vertexBufferMemory;
+	UniqueBuffer vertexBuffer;
+	UniqueDeviceMemory indexBufferMemory;
+	UniqueBuffer indexBuffer;
+
+	std::vector<MeshLod> lods;		// LOD 0 is full detail, all LODs share the vertex and index buffer
+
+	// bounding sphere in object space (for LOD selection)
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+
+	MeshBuffers() {}
+
+	MeshBuffers(const MeshBuffers&) = delete;
+	MeshBuffers& operator=(const MeshBuffers&) = delete;
+	MeshBuffers(MeshBuffers&&) = default;
+	MeshBuffers& operator=(MeshBuffers&&) = default;
+
+	// destroyed once the timeline reaches lastUseValue
+	void destroy(DeletionQueue& deletionQueue, uint64_t lastUseValue);
+
+	~MeshBuffers();
+};
+
+// create the buffers of a mesh, their contents are only valid once uploadBatch has been submitted
+// optimizationStatistics (may be nullptr) gets the ACMR/ATVR before and after if MESH_CREATE_OPTIMIZE_BIT is set
+MeshBuffers createMeshBuffers(DeviceMemoryInfo& memoryInfo, VkDevice device, UploadBatch& uploadBatch, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
+	MeshCreateFlags createFlags = 0, MeshOptimizationStatistics* optimizationStatistics = nullptr);
+
+// what the draw loop needs of one drawn mesh: buffers, LOD table, bounds and texture
+// buffers and LODs belong to the MeshBuffers it was made from (which must outlive it), so instances cost no more than this
 class Mesh
 {
 public:
 	Mesh();
-	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int newTexId);
+	Mesh(const MeshBuffers& buffers, TextureHandle newTexId);
 
-	void setModel(glm::mat4 newModel);
-	Model getModel();
-	Model* getModelRef();
+	TextureHandle getTexId();
 
-	int getTexId();
-
-	int getVertexCount();
 	VkBuffer getVertexBuffer();
-
-	int getIndexCount();
 	VkBuffer getIndexBuffer();
 
-	void destroyBuffers();
+	int getLodCount();
+	const MeshLod& getLod(int lod);
 
-	~Mesh();
+	glm::vec3 getBoundsCenter();
+	float getBoundsRadius();
 
 private:
-	Model model;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	const std::vector<MeshLod>* lods = nullptr;
 
-	int texId;
+	glm::vec3 boundsCenter;
+	float boundsRadius = 0.0f;
 
-	int vertexCount;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-
-	int indexCount;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
-
-	VkPhysicalDevice physicalDevice;
-	VkDevice device;
-
-	void createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
-	void createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices);
+	TextureHandle texId = 0;
 };
-
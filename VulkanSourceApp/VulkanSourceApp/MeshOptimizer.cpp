@@ -0,0 +1,417 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+// size of the cache the triangle scores are tuned for (larger than real hardware caches on purpose)
+static const uint32_t SCORE_CACHE_SIZE = 32;
+
+// size of the cache used to find cluster boundaries for overdraw optimization
+static const uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	// vertex not used by any more triangles, never pick it again
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// vertices of the triangle just emitted get a fixed score, so the next triangle doesn't simply reuse its edge
+			score = 0.75f;
+		}
+		else
+		{
+			// the older the vertex is in the cache, the lower the score
+			float scaler = 1.0f - float(cachePosition - 3) / float(SCORE_CACHE_SIZE - 3);
+			score = std::pow(scaler, 1.5f);
+		}
+	}
+
+	// boost vertices with few triangles left, so lone triangles get finished instead of left behind
+	score += 2.0f / std::sqrt(float(remainingTriangles));
+
+	return score;
+}
+
+// returns number of cache misses a triangle produces in the simulated FIFO cache (timestamp based, no cache list needed)
+static uint32_t simulateTriangle(const uint32_t* triangle, std::vector<uint32_t>& timestamps, uint32_t& timestamp, uint32_t cacheSize)
+{
+	uint32_t misses = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		uint32_t index = triangle[k];
+		if (timestamp - timestamps[index] > cacheSize)
+		{
+			timestamps[index] = timestamp++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics statistics;
+
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+	{
+		return statistics;
+	}
+
+	// start timestamp beyond the cache size so every vertex starts as a miss
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+
+	size_t misses = 0;
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		misses += simulateTriangle(&indices[i * 3], timestamps, timestamp, cacheSize);
+	}
+
+	// count referenced vertices only, so ATVR stays comparable after unused vertices are removed
+	std::vector<bool> referenced(vertexCount, false);
+	size_t referencedCount = 0;
+	for (uint32_t index : indices)
+	{
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			referencedCount++;
+		}
+	}
+
+	statistics.acmr = float(misses) / float(triangleCount);
+	statistics.atvr = float(misses) / float(referencedCount);
+
+	return statistics;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// -- ADJACENCY --
+	// for each vertex, list of triangles (not yet emitted) that use it
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t index : indices)
+	{
+		adjacencyOffsets[index + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+
+	std::vector<uint32_t> remainingTriangles(vertexCount);
+	std::vector<uint32_t> adjacency(indices.size());
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		remainingTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+	}
+
+	std::vector<uint32_t> fillCursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[fillCursor[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+		}
+	}
+
+	// -- INITIAL SCORES --
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	uint32_t bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+		{
+			bestTriangle = static_cast<uint32_t>(t);
+		}
+	}
+
+	// -- EMIT TRIANGLES --
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(SCORE_CACHE_SIZE + 3);
+	newCache.reserve(SCORE_CACHE_SIZE + 3);
+
+	size_t scanCursor = 0;
+	const uint32_t noTriangle = ~0u;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// nothing adjacent to the cache is left, so continue with the next triangle not emitted yet
+		if (bestTriangle == noTriangle)
+		{
+			while (emitted[scanCursor])
+			{
+				scanCursor++;
+			}
+			bestTriangle = static_cast<uint32_t>(scanCursor);
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+		emitted[bestTriangle] = true;
+
+		// remove emitted triangle from the adjacency of its vertices
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = triangle[k];
+			uint32_t* list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t i = 0; i < remainingTriangles[v]; i++)
+			{
+				if (list[i] == bestTriangle)
+				{
+					std::swap(list[i], list[remainingTriangles[v] - 1]);
+					remainingTriangles[v]--;
+					break;
+				}
+			}
+		}
+
+		// move the triangle's vertices to the front of the cache, everything else shifts back
+		newCache.assign(triangle, triangle + 3);
+		for (uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+			{
+				newCache.push_back(v);
+			}
+		}
+
+		// vertices pushed out of the cache lose their cache position
+		for (size_t i = SCORE_CACHE_SIZE; i < newCache.size(); i++)
+		{
+			cachePosition[newCache[i]] = -1;
+		}
+		for (size_t i = 0; i < newCache.size() && i < SCORE_CACHE_SIZE; i++)
+		{
+			cachePosition[newCache[i]] = static_cast<int>(i);
+		}
+
+		// rescore every vertex that moved (including evicted ones) and propagate the change to their triangles
+		for (uint32_t v : newCache)
+		{
+			float score = vertexScore(cachePosition[v], remainingTriangles[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const uint32_t* list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t i = 0; i < remainingTriangles[v]; i++)
+			{
+				triangleScores[list[i]] += delta;
+			}
+		}
+
+		if (newCache.size() > SCORE_CACHE_SIZE)
+		{
+			newCache.resize(SCORE_CACHE_SIZE);
+		}
+		cache.swap(newCache);
+
+		// next triangle is the best scoring one that touches the cache
+		bestTriangle = noTriangle;
+		float bestScore = -1.0f;
+		for (uint32_t v : cache)
+		{
+			const uint32_t* list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t i = 0; i < remainingTriangles[v]; i++)
+			{
+				if (triangleScores[list[i]] > bestScore)
+				{
+					bestScore = triangleScores[list[i]];
+					bestTriangle = list[i];
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> timestamps(vertices.size(), 0);
+	uint32_t timestamp = OVERDRAW_CACHE_SIZE + 1;
+
+	// -- HARD BOUNDARIES --
+	// a triangle that misses all 3 vertices starts from a cold cache, so the order can be cut there for free
+	std::vector<uint32_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (simulateTriangle(&indices[t * 3], timestamps, timestamp, OVERDRAW_CACHE_SIZE) == 3 || t == 0)
+		{
+			hardBoundaries.push_back(static_cast<uint32_t>(t));
+		}
+	}
+	hardBoundaries.push_back(static_cast<uint32_t>(triangleCount));
+
+	// -- SOFT BOUNDARIES --
+	// inside each hard cluster, cut wherever the local ACMR is still within threshold of the cluster's ACMR
+	std::vector<uint32_t> clusters;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+	{
+		uint32_t start = hardBoundaries[h];
+		uint32_t end = hardBoundaries[h + 1];
+
+		// ACMR of the whole hard cluster from a flushed cache
+		timestamp += OVERDRAW_CACHE_SIZE + 1;
+		uint32_t clusterMisses = 0;
+		for (uint32_t t = start; t < end; t++)
+		{
+			clusterMisses += simulateTriangle(&indices[t * 3], timestamps, timestamp, OVERDRAW_CACHE_SIZE);
+		}
+		float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		timestamp += OVERDRAW_CACHE_SIZE + 1;
+		clusters.push_back(start);
+		uint32_t clusterStart = start;
+		uint32_t misses = 0;
+		for (uint32_t t = start; t < end; t++)
+		{
+			misses += simulateTriangle(&indices[t * 3], timestamps, timestamp, OVERDRAW_CACHE_SIZE);
+
+			if (t + 1 < end && float(misses) / float(t + 1 - clusterStart) <= clusterThreshold)
+			{
+				// new cluster starts with a flushed cache, as it may be drawn in a different order
+				clusters.push_back(t + 1);
+				clusterStart = t + 1;
+				misses = 0;
+				timestamp += OVERDRAW_CACHE_SIZE + 1;
+			}
+		}
+	}
+
+	size_t clusterCount = clusters.size();
+	clusters.push_back(static_cast<uint32_t>(triangleCount));
+
+	// -- SORT CLUSTERS --
+	// mesh centroid is the reference point for how far "out" each cluster faces
+	glm::vec3 meshCentroid(0.0f);
+	for (const Vertex& vertex : vertices)
+	{
+		meshCentroid += vertex.pos;
+	}
+	meshCentroid /= float(vertices.size());
+
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].pos;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+
+			// length of the cross product is twice the triangle area, so it also area-weights the normal
+			glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+			float faceArea = glm::length(faceNormal);
+
+			centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+			normal += faceNormal;
+			area += faceArea;
+		}
+
+		float normalLength = glm::length(normal);
+		if (area > 0.0f && normalLength > 0.0f)
+		{
+			centroid /= area;
+			sortKeys[c] = glm::dot(centroid - meshCentroid, normal / normalLength);
+		}
+		else
+		{
+			sortKeys[c] = 0.0f;
+		}
+	}
+
+	// clusters facing furthest out of the mesh are most likely to occlude others, so draw those first
+	std::vector<uint32_t> clusterOrder(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		clusterOrder[c] = static_cast<uint32_t>(c);
+	}
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&sortKeys](uint32_t a, uint32_t b) {
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t c : clusterOrder)
+	{
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+
+	indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertices.size(), unused);
+
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	// vertices get new locations in the order the index buffer first references them
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(result);
+}
+
+MeshOptimizationStatistics optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	MeshOptimizationStatistics statistics;
+	statistics.before = analyzeVertexCache(indices, vertices.size());
+
+	// order matters: overdraw works on the clusters the cache order produces, and fetch order follows the final index order
+	optimizeVertexCache(indices, vertices.size());
+	optimizeOverdraw(indices, vertices);
+	optimizeVertexFetch(vertices, indices);
+
+	statistics.after = analyzeVertexCache(indices, vertices.size());
+
+	return statistics;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "Utilities.h"
+
+// post-transform vertex cache statistics of an index buffer
+struct VertexCacheStatistics {
+	float acmr = 0.0f;		// average cache miss ratio: vertex shader invocations per triangle (0.5 ideal, 3.0 worst)
+	float atvr = 0.0f;		// average transformed vertex ratio: vertex shader invocations per referenced vertex (1.0 ideal)
+};
+
+// statistics of a mesh before and after optimizeMesh()
+struct MeshOptimizationStatistics {
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+};
+
+// simulate a FIFO post-transform cache of cacheSize entries over the index buffer
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// reorder triangles so vertices are reused while still in the post-transform cache (Tom Forsyth's linear-speed algorithm)
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// split cache-optimized triangle order into clusters and sort them so outward facing clusters draw first, reducing overdraw
+// threshold : how much the ACMR of a cluster may degrade (1.05 = 5%) in exchange for finer clusters
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// reorder vertices in order of first use by the index buffer (removing unreferenced vertices) for vertex fetch locality
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// run the full pass (vertex cache -> overdraw -> vertex fetch) and report ACMR/ATVR before and after
+MeshOptimizationStatistics optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
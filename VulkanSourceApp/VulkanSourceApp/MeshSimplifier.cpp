@@ -0,0 +1,325 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+#include "MeshOptimizer.h"
+
+// symmetric 4x4 matrix of summed (area weighted) plane equations, plus the total weight
+struct Quadric {
+	double a2 = 0, ab = 0, ac = 0, ad = 0;
+	double b2 = 0, bc = 0, bd = 0;
+	double c2 = 0, cd = 0;
+	double d2 = 0;
+	double weight = 0;
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	float cost;
+};
+
+static void quadricAddPlane(Quadric& q, const glm::vec3& normal, float distance, double weight)
+{
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+
+	q.a2 += weight * a * a;	q.ab += weight * a * b;	q.ac += weight * a * c;	q.ad += weight * a * d;
+	q.b2 += weight * b * b;	q.bc += weight * b * c;	q.bd += weight * b * d;
+	q.c2 += weight * c * c;	q.cd += weight * c * d;
+	q.d2 += weight * d * d;
+	q.weight += weight;
+}
+
+static void quadricAdd(Quadric& q, const Quadric& r)
+{
+	q.a2 += r.a2;	q.ab += r.ab;	q.ac += r.ac;	q.ad += r.ad;
+	q.b2 += r.b2;	q.bc += r.bc;	q.bd += r.bd;
+	q.c2 += r.c2;	q.cd += r.cd;
+	q.d2 += r.d2;
+	q.weight += r.weight;
+}
+
+// weighted mean squared distance of point p to the planes summed in q
+static double quadricError(const Quadric& q, const glm::vec3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+
+	double error = q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x
+		+ q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y
+		+ q.c2 * z * z + 2 * q.cd * z
+		+ q.d2;
+
+	return q.weight > 0 ? std::fabs(error) / q.weight : 0.0;
+}
+
+static uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+// would moving "from" onto "to" turn any remaining triangle around "from" upside down?
+static bool collapseFlipsTriangle(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	const std::vector<uint32_t>& triangleOffsets, const std::vector<uint32_t>& triangleList, uint32_t from, uint32_t to)
+{
+	for (uint32_t i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++)
+	{
+		const uint32_t* triangle = &indices[triangleList[i] * 3];
+
+		// triangles on the collapsed edge disappear, they can't flip
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			continue;
+		}
+
+		glm::vec3 before[3];
+		glm::vec3 after[3];
+		for (int k = 0; k < 3; k++)
+		{
+			before[k] = vertices[triangle[k]].pos;
+			after[k] = triangle[k] == from ? vertices[to].pos : before[k];
+		}
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(normalBefore, normalAfter) < 0.0f)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float targetError, float* resultError)
+{
+	std::vector<uint32_t> result = indices;
+	size_t vertexCount = vertices.size();
+
+	// -- QUADRICS --
+	// every vertex starts with the planes of the triangles around it
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t < result.size() / 3; t++)
+	{
+		const glm::vec3& p0 = vertices[result[t * 3 + 0]].pos;
+		const glm::vec3& p1 = vertices[result[t * 3 + 1]].pos;
+		const glm::vec3& p2 = vertices[result[t * 3 + 2]].pos;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float doubleArea = glm::length(normal);
+		if (doubleArea == 0.0f)
+		{
+			continue;
+		}
+		normal /= doubleArea;
+
+		for (int k = 0; k < 3; k++)
+		{
+			quadricAddPlane(quadrics[result[t * 3 + k]], normal, -glm::dot(normal, p0), doubleArea * 0.5);
+		}
+	}
+
+	// -- LOCKED VERTICES --
+	// edges used by one triangle are borders, edges used by more than two are non-manifold: keep both in place
+	std::unordered_map<uint64_t, uint32_t> edgeUseCount;
+	for (size_t t = 0; t < result.size() / 3; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			edgeUseCount[edgeKey(result[t * 3 + k], result[t * 3 + (k + 1) % 3])]++;
+		}
+	}
+
+	std::vector<bool> locked(vertexCount, false);
+	for (const auto& edge : edgeUseCount)
+	{
+		if (edge.second != 2)
+		{
+			locked[uint32_t(edge.first >> 32)] = true;
+			locked[uint32_t(edge.first & 0xffffffff)] = true;
+		}
+	}
+
+	double maxCollapseError = double(targetError) * double(targetError);
+	double largestError = 0.0;
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> triangleList;
+	std::vector<Collapse> collapses;
+
+	// -- COLLAPSE PASSES --
+	// each pass collapses the cheapest independent edges, then rebuilds the triangle list
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+
+		// vertex -> triangle adjacency of the current triangles (used for the flip test)
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : result)
+		{
+			triangleOffsets[index + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		}
+		triangleList.resize(result.size());
+		std::vector<uint32_t> fillCursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				triangleList[fillCursor[result[t * 3 + k]]++] = static_cast<uint32_t>(t);
+			}
+		}
+
+		// cost of every edge in both directions, cheapest first
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t a = result[t * 3 + k];
+				uint32_t b = result[t * 3 + (k + 1) % 3];
+
+				for (int direction = 0; direction < 2; direction++)
+				{
+					uint32_t from = direction == 0 ? a : b;
+					uint32_t to = direction == 0 ? b : a;
+					if (locked[from])
+					{
+						continue;
+					}
+
+					Quadric combined = quadrics[from];
+					quadricAdd(combined, quadrics[to]);
+					collapses.push_back({ from, to, float(quadricError(combined, vertices[to].pos)) });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.cost < b.cost;
+		});
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = static_cast<uint32_t>(v);
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		// an interior edge collapse removes 2 triangles, so stop once that would reach the target
+		size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+		size_t trianglesRemoved = 0;
+		size_t collapseCount = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > maxCollapseError || trianglesRemoved >= trianglesToRemove)
+			{
+				break;
+			}
+
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			if (collapseFlipsTriangle(vertices, result, triangleOffsets, triangleList, collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadricAdd(quadrics[collapse.to], quadrics[collapse.from]);
+
+			// keep the whole neighbourhood out of this pass, so the flip test above stays valid for later collapses
+			for (uint32_t i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++)
+			{
+				const uint32_t* triangle = &result[triangleList[i] * 3];
+				touched[triangle[0]] = true;
+				touched[triangle[1]] = true;
+				touched[triangle[2]] = true;
+			}
+
+			largestError = std::max(largestError, double(collapse.cost));
+			trianglesRemoved += 2;
+			collapseCount++;
+		}
+
+		// no edge could be collapsed within the error limit, mesh is as simple as it gets
+		if (collapseCount == 0)
+		{
+			break;
+		}
+
+		// apply collapses and drop triangles that became degenerate
+		size_t write = 0;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t a = remap[result[t * 3 + 0]];
+			uint32_t b = remap[result[t * 3 + 1]];
+			uint32_t c = remap[result[t * 3 + 2]];
+
+			if (a != b && b != c && c != a)
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	if (resultError)
+	{
+		*resultError = float(std::sqrt(largestError));
+	}
+
+	return result;
+}
+
+std::vector<MeshLod> generateLodChain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, int maxLodCount)
+{
+	std::vector<MeshLod> lods;
+
+	// LOD 0 is the mesh as given
+	uint32_t fullIndexCount = static_cast<uint32_t>(indices.size());
+	lods.push_back({ 0, fullIndexCount, 0.0f });
+
+	// always simplify from the full detail mesh, so the error is measured against what LOD 0 shows
+	std::vector<uint32_t> fullIndices(indices.begin(), indices.end());
+	size_t targetIndexCount = fullIndexCount;
+
+	while (static_cast<int>(lods.size()) < maxLodCount)
+	{
+		targetIndexCount = (targetIndexCount / 2) / 3 * 3;
+		if (targetIndexCount < 3)
+		{
+			break;
+		}
+
+		float error = 0.0f;
+		std::vector<uint32_t> lodIndices = simplifyMesh(vertices, fullIndices, targetIndexCount, std::numeric_limits<float>::max(), &error);
+
+		// stop when simplification stalls (e.g. everything left is locked border), a LOD this close to the last isn't worth it
+		if (lodIndices.empty() || lodIndices.size() > lods.back().indexCount * 9 / 10)
+		{
+			break;
+		}
+
+		optimizeVertexCache(lodIndices, vertices.size());
+
+		// errors must not decrease along the chain, selection picks the coarsest LOD under the threshold
+		error = std::max(error, lods.back().error);
+
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), error });
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
+	return lods;
+}
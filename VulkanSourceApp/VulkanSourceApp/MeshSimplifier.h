@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "Utilities.h"
+
+const int MAX_MESH_LODS = 6;
+
+// one level of detail: a range inside the mesh's (shared) index buffer
+struct MeshLod {
+	uint32_t firstIndex;		// first index of this LOD in the index buffer
+	uint32_t indexCount;		// number of indices to draw
+	float error;				// object space deviation from the full detail mesh (0 for LOD 0)
+};
+
+// simplify a triangle list with edge collapses ordered by a quadric error metric
+// vertices are only collapsed onto existing vertices, so the result indexes the same vertex buffer
+// border vertices (incl. uv/color seams, which are borders in index topology) are locked to avoid cracks
+// targetIndexCount	: stop once the index count drops to this
+// targetError			: stop before any collapse with a larger object space error
+// resultError			: (optional) largest object space error introduced
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+// build a LOD chain by repeatedly halving the triangle count of the full detail mesh
+// new LODs are appended to indices, LOD 0 is the original index range
+std::vector<MeshLod> generateLodChain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, int maxLodCount = MAX_MESH_LODS);
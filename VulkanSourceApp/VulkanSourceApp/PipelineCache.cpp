@@ -0,0 +1,151 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "PipelineCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+// header at the start of all cache data (VkPipelineCacheHeaderVersionOne), read field by field from the raw bytes
+static bool isPipelineCacheCompatible(VkPhysicalDevice physicalDevice, const std::vector<char>& data)
+{
+	const size_t headerSize = 16 + VK_UUID_SIZE;
+	if (data.size() < headerSize)
+	{
+		return false;
+	}
+
+	uint32_t header[4];		// header size, header version, vendor id, device id
+	uint8_t cacheUUID[VK_UUID_SIZE];
+	memcpy(header, data.data(), sizeof(header));
+	memcpy(cacheUUID, data.data() + sizeof(header), VK_UUID_SIZE);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	return header[0] >= headerSize && header[0] <= data.size()
+		&& header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header[2] == deviceProperties.vendorID
+		&& header[3] == deviceProperties.deviceID
+		&& memcmp(cacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache loadPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& fileName)
+{
+	// missing file is normal on first launch, just start empty
+	std::vector<char> cacheData;
+	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		cacheData.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(cacheData.data(), cacheData.size());
+		if (!file)
+		{
+			cacheData.clear();
+		}
+		file.close();
+	}
+
+	// data of another GPU or driver version is useless (and drivers aren't required to reject it gracefully)
+	if (!cacheData.empty() && !isPipelineCacheCompatible(physicalDevice, cacheData))
+	{
+		printf("Pipeline cache %s was created by a different device or driver, starting with an empty cache\n", fileName.c_str());
+		cacheData.clear();
+	}
+
+	VkPipelineCacheCreateInfo cacheCreateInfo = {};
+	cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheCreateInfo.initialDataSize = cacheData.size();
+	cacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+	VkPipelineCache pipelineCache;
+	VkResult result = vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &pipelineCache);
+
+	// retry without the file's data before giving up
+	if (result != VK_SUCCESS && !cacheData.empty())
+	{
+		cacheCreateInfo.initialDataSize = 0;
+		cacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &pipelineCache);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create a pipeline cache");
+	}
+
+	return pipelineCache;
+}
+
+bool savePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const std::string& fileName)
+{
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+	{
+		return false;
+	}
+
+	std::vector<char> cacheData(dataSize);
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	// write everything to a temporary file first
+	std::string tempFileName = fileName + ".tmp";
+	std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		printf("Failed to save pipeline cache to %s\n", tempFileName.c_str());
+		return false;
+	}
+
+	file.write(cacheData.data(), dataSize);
+	file.close();
+	if (!file)
+	{
+		printf("Failed to save pipeline cache to %s\n", tempFileName.c_str());
+		std::remove(tempFileName.c_str());
+		return false;
+	}
+
+	// then swap it in with a single rename (std::rename won't replace an existing file on Windows)
+	// the data has to be on disk before the rename is, or a crash in between can leave a truncated cache in place of the good one
+	// (MOVEFILE_WRITE_THROUGH does that on Windows, fsync() of the temporary file elsewhere)
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	int tempFile = open(tempFileName.c_str(), O_WRONLY);
+	bool synced = tempFile >= 0 && fsync(tempFile) == 0;
+	if (tempFile >= 0)
+	{
+		close(tempFile);
+	}
+	if (!synced)
+	{
+		printf("Failed to save pipeline cache to %s\n", tempFileName.c_str());
+		std::remove(tempFileName.c_str());
+		return false;
+	}
+
+	bool renamed = std::rename(tempFileName.c_str(), fileName.c_str()) == 0;
+#endif
+	if (!renamed)
+	{
+		printf("Failed to replace pipeline cache %s\n", fileName.c_str());
+		std::remove(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+// file the renderer keeps its pipeline cache in (next to the executable's working directory, like Shaders/)
+const std::string PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+// create a pipeline cache, seeded with the data in fileName if its header was written by the same driver/device
+// (vendor id, device id and pipelineCacheUUID must match, otherwise the data is dropped and the cache starts empty)
+VkPipelineCache loadPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& fileName);
+
+// write the cache's data to fileName, through a temporary file that replaces the old one in one rename
+// so a crash while saving never leaves a half written cache behind, returns false (and keeps the old file) on failure
+bool savePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const std::string& fileName);
@@ -0,0 +1,687 @@
+#include "PipelineRegistry.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// FNV-1a, continued from hash so several fields can be chained
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+template<typename T>
+static uint64_t hashValue(const T& value, uint64_t hash)
+{
+	return hashBytes(&value, sizeof(T), hash);
+}
+
+PipelineState createDefaultPipelineState()
+{
+	PipelineState state = {};
+	state.vertexShader = "Shaders/vert.spv";
+	state.fragmentShader = "Shaders/frag.spv";
+	state.shaderFeatures = SHADER_FEATURE_TEXTURE_BIT;
+
+	state.vertexStride = sizeof(Vertex);
+	state.vertexAttributeCount = 3;
+	state.vertexAttributes[0] = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) };		// location, binding, format, offset
+	state.vertexAttributes[1] = { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, col) };
+	state.vertexAttributes[2] = { 2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, tex) };
+
+	state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	state.polygonMode = VK_POLYGON_MODE_FILL;
+	state.cullMode = VK_CULL_MODE_BACK_BIT;
+	state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	state.blendEnable = VK_TRUE;
+	state.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	state.colorBlendOp = VK_BLEND_OP_ADD;
+	state.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	state.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	state.depthTestEnable = VK_TRUE;
+	state.depthWriteEnable = VK_TRUE;
+	state.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	return state;
+}
+
+PipelineRegistry::PipelineRegistry()
+{
+}
+
+void PipelineRegistry::init(VkDevice newDevice, VkPipelineCache newPipelineCache, VkPipelineLayout newPipelineLayout, VkRenderPass newRenderPass, uint32_t workerCount, bool newUseLibraries)
+{
+	device = newDevice;
+	pipelineCache = newPipelineCache;
+	pipelineLayout = newPipelineLayout;
+	renderPass = newRenderPass;
+	useLibraries = newUseLibraries;
+	stopping = false;
+
+	for (uint32_t i = 0; i < std::max(workerCount, 1u); i++)
+	{
+		workers.emplace_back(&PipelineRegistry::workerLoop, this);
+	}
+}
+
+PipelineKey PipelineRegistry::request(const PipelineState& state)
+{
+	const ByteSpan& vertexCode = getShaderCode(state.vertexShader);
+	const ByteSpan& fragmentCode = getShaderCode(state.fragmentShader);
+
+	PipelineKey key = hashState(state, vertexCode, fragmentCode);
+	if (entries.count(key))
+	{
+		return key;
+	}
+
+	std::unique_ptr<PipelineEntry> entry(new PipelineEntry());
+	entry->state = state;
+	entry->vertexShaderCode = &vertexCode;
+	entry->fragmentShaderCode = &fragmentCode;
+	entry->status = PIPELINE_STATUS_PENDING;
+	entry->optimized = false;
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(entry.get());
+	}
+	jobCondition.notify_one();
+
+	entries[key] = std::move(entry);
+	return key;
+}
+
+VkPipeline PipelineRegistry::get(PipelineKey key)
+{
+	auto it = entries.find(key);
+	if (it == entries.end())
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	// link time optimized version replaces the fast linked one once it's there
+	PipelineEntry* entry = it->second.get();
+	if (entry->optimized.load(std::memory_order_acquire))
+	{
+		return entry->optimizedPipeline;
+	}
+	if (entry->status.load(std::memory_order_acquire) != PIPELINE_STATUS_READY)
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	return entry->pipeline;
+}
+
+bool PipelineRegistry::isPending(PipelineKey key)
+{
+	auto it = entries.find(key);
+	return it != entries.end() && it->second->status.load(std::memory_order_acquire) == PIPELINE_STATUS_PENDING;
+}
+
+VkPipeline PipelineRegistry::wait(PipelineKey key)
+{
+	auto it = entries.find(key);
+	if (it == entries.end())
+	{
+		throw std::runtime_error("waiting for a pipeline that was never requested");
+	}
+
+	PipelineEntry* entry = it->second.get();
+	{
+		std::unique_lock<std::mutex> lock(jobMutex);
+		doneCondition.wait(lock, [entry] { return entry->status.load() != PIPELINE_STATUS_PENDING; });
+	}
+
+	if (entry->status.load() == PIPELINE_STATUS_FAILED)
+	{
+		throw std::runtime_error("faild to create a graphics pipeline!");
+	}
+
+	return entry->pipeline;
+}
+
+void PipelineRegistry::destroy()
+{
+	// let running compiles finish, queued ones are dropped
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+		jobs.clear();
+		relinkJobs.clear();
+	}
+	jobCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+
+	// fast linked pipelines are only destroyed here, command buffers may still have used them after the optimized one arrived
+	for (auto& entry : entries)
+	{
+		if (entry.second->status.load() == PIPELINE_STATUS_READY)
+		{
+			vkDestroyPipeline(device, entry.second->pipeline, nullptr);
+		}
+		if (entry.second->optimized.load())
+		{
+			vkDestroyPipeline(device, entry.second->optimizedPipeline, nullptr);
+		}
+	}
+	entries.clear();
+
+	// linked pipelines don't depend on their libraries, so those go last
+	for (auto& libraryPartMap : libraryParts)
+	{
+		for (auto& libraryPart : libraryPartMap)
+		{
+			vkDestroyPipeline(device, libraryPart.second, nullptr);
+		}
+		libraryPartMap.clear();
+	}
+	shaderCode.clear();
+	shaderFiles.clear();
+}
+
+const ByteSpan& PipelineRegistry::getShaderCode(const std::string& fileName)
+{
+	auto it = shaderCode.find(fileName);
+	if (it == shaderCode.end())
+	{
+		// embedded code saves the file read at startup, otherwise the mapped file is used as is
+		// (both start at least 4 byte aligned, as vkCreateShaderModule wants)
+		ByteSpan code;
+		if (!findEmbeddedShader(fileName, &code))
+		{
+			// the .spv files aren't committed, only the CompileShaders target of the project or compile_shaders.sh makes them
+			MappedFile file;
+			if (!file.open(fileName))
+			{
+				throw std::runtime_error("Failed to open a shader! (" + fileName + ", run Shaders/compile_shaders.sh when not building with the Visual Studio project)");
+			}
+			code = file.span();
+			shaderFiles[fileName] = std::move(file);		// moving it doesn't move the mapping, the span stays valid
+		}
+		it = shaderCode.emplace(fileName, code).first;
+	}
+	return it->second;
+}
+
+// each part of a pipeline is hashed on its own, so library parts can be shared between pipelines
+// (field by field, padding bytes of the struct would make equal states hash differently)
+static uint64_t hashVertexInputState(const PipelineState& state)
+{
+	uint64_t hash = hashValue(state.vertexStride, 14695981039346656037ull);
+	hash = hashValue(state.vertexAttributeCount, hash);
+	for (uint32_t i = 0; i < state.vertexAttributeCount; i++)
+	{
+		hash = hashValue(state.vertexAttributes[i].location, hash);
+		hash = hashValue(state.vertexAttributes[i].format, hash);
+		hash = hashValue(state.vertexAttributes[i].offset, hash);
+	}
+	return hashValue(state.topology, hash);
+}
+
+static uint64_t hashPreRasterizationState(const PipelineState& state, const ByteSpan& vertexCode)
+{
+	// hash the shader code rather than the file names, so a rebuilt .spv makes a new pipeline
+	uint64_t hash = hashBytes(vertexCode.data(), vertexCode.size());
+	hash = hashValue(state.polygonMode, hash);
+	hash = hashValue(state.cullMode, hash);
+	return hashValue(state.frontFace, hash);
+}
+
+static uint64_t hashFragmentShaderState(const PipelineState& state, const ByteSpan& fragmentCode)
+{
+	uint64_t hash = hashBytes(fragmentCode.data(), fragmentCode.size());
+	hash = hashValue(state.shaderFeatures, hash);
+	hash = hashValue(state.depthTestEnable, hash);
+	hash = hashValue(state.depthWriteEnable, hash);
+	return hashValue(state.depthCompareOp, hash);
+}
+
+static uint64_t hashFragmentOutputState(const PipelineState& state)
+{
+	uint64_t hash = hashValue(state.blendEnable, 14695981039346656037ull);
+	hash = hashValue(state.srcColorBlendFactor, hash);
+	hash = hashValue(state.dstColorBlendFactor, hash);
+	hash = hashValue(state.colorBlendOp, hash);
+	hash = hashValue(state.srcAlphaBlendFactor, hash);
+	hash = hashValue(state.dstAlphaBlendFactor, hash);
+	return hashValue(state.alphaBlendOp, hash);
+}
+
+PipelineKey PipelineRegistry::hashState(const PipelineState& state, const ByteSpan& vertexCode, const ByteSpan& fragmentCode)
+{
+	uint64_t hash = hashValue(hashVertexInputState(state), 14695981039346656037ull);
+	hash = hashValue(hashPreRasterizationState(state, vertexCode), hash);
+	hash = hashValue(hashFragmentShaderState(state, fragmentCode), hash);
+	hash = hashValue(hashFragmentOutputState(state), hash);
+
+	return hash != 0 ? hash : 1;
+}
+
+void PipelineRegistry::workerLoop()
+{
+	while (true)
+	{
+		PipelineEntry* entry;
+		bool optimize;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobCondition.wait(lock, [this] { return stopping || !jobs.empty() || !relinkJobs.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			// new pipelines first, optimizing ones that already work can wait
+			optimize = jobs.empty();
+			std::deque<PipelineEntry*>& queue = optimize ? relinkJobs : jobs;
+			entry = queue.front();
+			queue.pop_front();
+		}
+
+		if (optimize)
+		{
+			// the fast linked pipeline stays in use until the optimized one is ready (and if optimizing fails)
+			try
+			{
+				entry->optimizedPipeline = linkPipeline(*entry, true);
+				entry->optimized.store(true, std::memory_order_release);
+			}
+			catch (const std::runtime_error& e)
+			{
+				printf("ERROR: %s (%s, %s)\n", e.what(), entry->state.vertexShader.c_str(), entry->state.fragmentShader.c_str());
+			}
+			continue;
+		}
+
+		// compile outside the lock, vkCreateGraphicsPipelines and the pipeline cache are safe to use from several threads
+		int status = PIPELINE_STATUS_READY;
+		try
+		{
+			entry->pipeline = useLibraries ? linkPipeline(*entry, false) : compilePipeline(*entry);
+		}
+		catch (const std::runtime_error& e)
+		{
+			printf("ERROR: %s (%s, %s)\n", e.what(), entry->state.vertexShader.c_str(), entry->state.fragmentShader.c_str());
+			status = PIPELINE_STATUS_FAILED;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			entry->status.store(status, std::memory_order_release);
+
+			// fast link is usable now, queue the link time optimized version behind it
+			if (useLibraries && status == PIPELINE_STATUS_READY)
+			{
+				relinkJobs.push_back(entry);
+			}
+		}
+		doneCondition.notify_all();
+		jobCondition.notify_one();
+	}
+}
+
+// create infos of every fixed function stage of a PipelineState
+// members point at each other, so it's filled in place and never copied
+struct FixedFunctionState {
+	VkVertexInputBindingDescription bindingDescription;
+	VkPipelineVertexInputStateCreateInfo vertexInput;
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+	VkPipelineViewportStateCreateInfo viewportState;
+	std::array<VkDynamicState, 2> dynamicStateEnables;
+	VkPipelineDynamicStateCreateInfo dynamicState;
+	VkPipelineRasterizationStateCreateInfo rasterizer;
+	VkPipelineMultisampleStateCreateInfo multisampling;
+	VkPipelineColorBlendAttachmentState colorState;
+	VkPipelineColorBlendStateCreateInfo colorBlending;
+	VkPipelineDepthStencilStateCreateInfo depthStencil;
+	std::array<VkBool32, SHADER_FEATURE_COUNT> fragmentFeatures;
+	std::array<VkSpecializationMapEntry, SHADER_FEATURE_COUNT> fragmentSpecializationEntries;
+	VkSpecializationInfo fragmentSpecialization;
+};
+
+static void fillFixedFunctionState(const PipelineState& state, FixedFunctionState* infos)
+{
+	// how the data for a single vertex (including info such as position, color, texture, coords, normals, etc) is as a whole
+	infos->bindingDescription = {};
+	infos->bindingDescription.binding = 0;															// can bind multiple streams of data, this defines which one
+	infos->bindingDescription.stride = state.vertexStride;									// size of a single vertex object
+	infos->bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;		// how to move between data after each vertex
+
+	// -- VERTEX INPUT --
+	infos->vertexInput = {};
+	infos->vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	infos->vertexInput.vertexBindingDescriptionCount = 1;
+	infos->vertexInput.pVertexBindingDescriptions = &infos->bindingDescription;		// list of vertex binding descritions (data spacing/stride information)
+	infos->vertexInput.vertexAttributeDescriptionCount = state.vertexAttributeCount;
+	infos->vertexInput.pVertexAttributeDescriptions = state.vertexAttributes;			// list of vertex attribute descriptions (data format and where to bind to/from)
+
+	// -- INPUT ASSEMBLY --
+	infos->inputAssembly = {};
+	infos->inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	infos->inputAssembly.topology = state.topology;						// primitive type to assemble vertices as
+	infos->inputAssembly.primitiveRestartEnable = VK_FALSE;				// allow overriding of "strip" topology to start new primitives
+
+	// -- VIEWPORT & SCISSOR --
+	// counts only, the actual rectangles are set while recording (dynamic state below)
+	infos->viewportState = {};
+	infos->viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	infos->viewportState.viewportCount = 1;
+	infos->viewportState.scissorCount = 1;
+
+	// -- DYNAMIC STATES --
+	// pipelines outlive swapchain sizes, so viewport and scissor are set with vkCmdSetViewport/vkCmdSetScissor
+	infos->dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	infos->dynamicState = {};
+	infos->dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	infos->dynamicState.dynamicStateCount = static_cast<uint32_t>(infos->dynamicStateEnables.size());
+	infos->dynamicState.pDynamicStates = infos->dynamicStateEnables.data();
+
+	// -- RASTERIZER --
+	infos->rasterizer = {};
+	infos->rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	infos->rasterizer.depthClampEnable = VK_FALSE;			// change if fragments beyond near/far planes are clipped (default) or clamped to plane
+	infos->rasterizer.rasterizerDiscardEnable = VK_FALSE;	// whether to discard data and skip rasterizer. never creates fragments, only suitable for pipeline without framebuffer output
+	infos->rasterizer.polygonMode = state.polygonMode;		// how to handle filling points between vertices
+	infos->rasterizer.lineWidth = 1.0f;						// how thick lines should be when drawn
+	infos->rasterizer.cullMode = state.cullMode;			// which faceof a tri to cull
+	infos->rasterizer.frontFace = state.frontFace;			// winding to determine wichi side is front
+	infos->rasterizer.depthBiasEnable = VK_FALSE;			// whether to add depth bias to framents (good for stopping "shadow acne" in shadow mapping)
+
+	// -- MULTISAMPLING --
+	infos->multisampling = {};
+	infos->multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	infos->multisampling.sampleShadingEnable = VK_FALSE;					// enable multisample shading or not
+	infos->multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;	// number of sample to use per fragment
+
+	// -- BLENDING --
+	// blend attachment state (how blending is handled)
+	infos->colorState = {};
+	infos->colorState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;		// colors to apply blending to
+	infos->colorState.blendEnable = state.blendEnable;
+
+	//blending uses equation: (srcColorBlendFactor * new color) colorBlendOp (dstColorblendFactor * old color)
+	infos->colorState.srcColorBlendFactor = state.srcColorBlendFactor;
+	infos->colorState.dstColorBlendFactor = state.dstColorBlendFactor;
+	infos->colorState.colorBlendOp = state.colorBlendOp;
+	infos->colorState.srcAlphaBlendFactor = state.srcAlphaBlendFactor;
+	infos->colorState.dstAlphaBlendFactor = state.dstAlphaBlendFactor;
+	infos->colorState.alphaBlendOp = state.alphaBlendOp;
+
+	infos->colorBlending = {};
+	infos->colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	infos->colorBlending.logicOpEnable = VK_FALSE;			// alternative to calculations is to use logical operations
+	infos->colorBlending.attachmentCount = 1;
+	infos->colorBlending.pAttachments = &infos->colorState;
+
+	// -- DEPTH STENCIL TESTING --
+	infos->depthStencil = {};
+	infos->depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	infos->depthStencil.depthTestEnable = state.depthTestEnable;		// enable checking depth to determin fragment write
+	infos->depthStencil.depthWriteEnable = state.depthWriteEnable;		// enable writing wo depth buffer( to replace old values)
+	infos->depthStencil.depthCompareOp = state.depthCompareOp;			// comparison operation that allows an overwrite (is in front)
+	infos->depthStencil.depthBoundsTestEnable = VK_FALSE;				// depth bounds test: does the depth value exist between two bounds
+	infos->depthStencil.stencilTestEnable = VK_FALSE;					// enable stencil test
+
+	// -- SPECIALIZATION --
+	// one bool constant per feature bit, constant_id = bit index
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++)
+	{
+		infos->fragmentFeatures[i] = (state.shaderFeatures & (1u << i)) ? VK_TRUE : VK_FALSE;
+		infos->fragmentSpecializationEntries[i].constantID = i;
+		infos->fragmentSpecializationEntries[i].offset = static_cast<uint32_t>(i * sizeof(VkBool32));
+		infos->fragmentSpecializationEntries[i].size = sizeof(VkBool32);
+	}
+
+	infos->fragmentSpecialization = {};
+	infos->fragmentSpecialization.mapEntryCount = SHADER_FEATURE_COUNT;
+	infos->fragmentSpecialization.pMapEntries = infos->fragmentSpecializationEntries.data();
+	infos->fragmentSpecialization.dataSize = sizeof(infos->fragmentFeatures);
+	infos->fragmentSpecialization.pData = infos->fragmentFeatures.data();
+}
+
+static VkPipelineShaderStageCreateInfo createShaderStageInfo(VkShaderStageFlagBits stage, VkShaderModule shaderModule)
+{
+	VkPipelineShaderStageCreateInfo shaderStageCreateInfo = {};
+	shaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStageCreateInfo.stage = stage;						// shader stage name
+	shaderStageCreateInfo.module = shaderModule;				// shader module to be used by stage
+	shaderStageCreateInfo.pName = "main";						// engry point in to shader ("main" function in shader.vert)
+	return shaderStageCreateInfo;
+}
+
+VkPipeline PipelineRegistry::compilePipeline(const PipelineEntry& entry)
+{
+	// create shader modules
+	VkShaderModule vertexShaderModule = createShaderModule(*entry.vertexShaderCode);
+	VkShaderModule fragmentShaderModule;
+	try
+	{
+		fragmentShaderModule = createShaderModule(*entry.fragmentShaderCode);
+	}
+	catch (const std::runtime_error&)
+	{
+		vkDestroyShaderModule(device, vertexShaderModule, nullptr);
+		throw;
+	}
+
+	// graphics pipeline creation info requires array of shader stage creates
+	VkPipelineShaderStageCreateInfo shaderStages[] = {
+		createShaderStageInfo(VK_SHADER_STAGE_VERTEX_BIT, vertexShaderModule),
+		createShaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule)
+	};
+
+	FixedFunctionState infos;
+	fillFixedFunctionState(entry.state, &infos);
+	shaderStages[1].pSpecializationInfo = &infos.fragmentSpecialization;
+
+	// -- GRAPHICS PIPELINE CREATION --
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stageCount = 2;									// number of shader stages
+	pipelineCreateInfo.pStages = shaderStages;							// list of shader stages
+	pipelineCreateInfo.pVertexInputState = &infos.vertexInput;			// all the fixed function pipeline stages
+	pipelineCreateInfo.pInputAssemblyState = &infos.inputAssembly;
+	pipelineCreateInfo.pViewportState = &infos.viewportState;
+	pipelineCreateInfo.pDynamicState = &infos.dynamicState;
+	pipelineCreateInfo.pRasterizationState = &infos.rasterizer;
+	pipelineCreateInfo.pMultisampleState = &infos.multisampling;
+	pipelineCreateInfo.pColorBlendState = &infos.colorBlending;
+	pipelineCreateInfo.pDepthStencilState = &infos.depthStencil;
+	pipelineCreateInfo.layout = pipelineLayout;							// pipeline layout pipeline shoudld use
+	pipelineCreateInfo.renderPass = renderPass;							// render pass description the pipeline is compatible with
+	pipelineCreateInfo.subpass = 0;										// subpass of render pass to use with pipeline
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	// create graphics pipeline
+	VkPipeline pipeline;
+	VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+
+	// destroy shader modules, no longer needed after pipeline created
+	vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
+	vkDestroyShaderModule(device, vertexShaderModule, nullptr);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("faild to create a graphics pipeline!");
+	}
+
+	return pipeline;
+}
+
+VkPipeline PipelineRegistry::linkPipeline(const PipelineEntry& entry, bool optimize)
+{
+	const PipelineState& state = entry.state;
+
+	// parts are shared by every pipeline with the same state for that part
+	std::array<VkPipeline, PIPELINE_LIBRARY_PART_COUNT> libraries = {
+		getLibraryPart(PIPELINE_LIBRARY_VERTEX_INPUT, hashVertexInputState(state), entry),
+		getLibraryPart(PIPELINE_LIBRARY_PRE_RASTERIZATION, hashPreRasterizationState(state, *entry.vertexShaderCode), entry),
+		getLibraryPart(PIPELINE_LIBRARY_FRAGMENT_SHADER, hashFragmentShaderState(state, *entry.fragmentShaderCode), entry),
+		getLibraryPart(PIPELINE_LIBRARY_FRAGMENT_OUTPUT, hashFragmentOutputState(state), entry)
+	};
+
+	VkPipelineLibraryCreateInfoKHR libraryCreateInfo = {};
+	libraryCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraryCreateInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+	libraryCreateInfo.pLibraries = libraries.data();
+
+	// without link time optimization linking is meant to be cheap enough to do while a frame waits for it
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = &libraryCreateInfo;
+	pipelineCreateInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+	pipelineCreateInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline;
+	VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("faild to link a graphics pipeline!");
+	}
+
+	return pipeline;
+}
+
+VkPipeline PipelineRegistry::getLibraryPart(PipelineLibraryPart part, uint64_t partKey, const PipelineEntry& entry)
+{
+	{
+		std::lock_guard<std::mutex> lock(libraryMutex);
+		auto it = libraryParts[part].find(partKey);
+		if (it != libraryParts[part].end())
+		{
+			return it->second;
+		}
+	}
+
+	// build without holding the lock, other workers may link pipelines from existing parts meanwhile
+	VkPipeline newPart = createLibraryPart(part, entry);
+
+	std::lock_guard<std::mutex> lock(libraryMutex);
+	auto inserted = libraryParts[part].emplace(partKey, newPart);
+	if (!inserted.second)
+	{
+		// another worker built the same part first
+		vkDestroyPipeline(device, newPart, nullptr);
+	}
+	return inserted.first->second;
+}
+
+VkPipeline PipelineRegistry::createLibraryPart(PipelineLibraryPart part, const PipelineEntry& entry)
+{
+	FixedFunctionState infos;
+	fillFixedFunctionState(entry.state, &infos);
+
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo = {};
+	libraryCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+
+	// parts keep what link time optimization needs, so they can be relinked into an optimized pipeline later
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = &libraryCreateInfo;
+	pipelineCreateInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+	VkPipelineShaderStageCreateInfo shaderStage;
+
+	// each part only gets the state that belongs to it
+	switch (part)
+	{
+	case PIPELINE_LIBRARY_VERTEX_INPUT:
+		libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+		pipelineCreateInfo.pVertexInputState = &infos.vertexInput;
+		pipelineCreateInfo.pInputAssemblyState = &infos.inputAssembly;
+		break;
+
+	case PIPELINE_LIBRARY_PRE_RASTERIZATION:
+		libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+		shaderModule = createShaderModule(*entry.vertexShaderCode);
+		shaderStage = createShaderStageInfo(VK_SHADER_STAGE_VERTEX_BIT, shaderModule);
+		pipelineCreateInfo.stageCount = 1;
+		pipelineCreateInfo.pStages = &shaderStage;
+		pipelineCreateInfo.pViewportState = &infos.viewportState;
+		pipelineCreateInfo.pRasterizationState = &infos.rasterizer;
+		pipelineCreateInfo.pDynamicState = &infos.dynamicState;
+		pipelineCreateInfo.layout = pipelineLayout;
+		pipelineCreateInfo.renderPass = renderPass;
+		break;
+
+	case PIPELINE_LIBRARY_FRAGMENT_SHADER:
+		libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+		shaderModule = createShaderModule(*entry.fragmentShaderCode);
+		shaderStage = createShaderStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, shaderModule);
+		shaderStage.pSpecializationInfo = &infos.fragmentSpecialization;
+		pipelineCreateInfo.stageCount = 1;
+		pipelineCreateInfo.pStages = &shaderStage;
+		pipelineCreateInfo.pMultisampleState = &infos.multisampling;
+		pipelineCreateInfo.pDepthStencilState = &infos.depthStencil;
+		pipelineCreateInfo.layout = pipelineLayout;
+		pipelineCreateInfo.renderPass = renderPass;
+		break;
+
+	case PIPELINE_LIBRARY_FRAGMENT_OUTPUT:
+		libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+		pipelineCreateInfo.pColorBlendState = &infos.colorBlending;
+		pipelineCreateInfo.pMultisampleState = &infos.multisampling;
+		pipelineCreateInfo.renderPass = renderPass;
+		break;
+
+	default:
+		throw std::runtime_error("unknown pipeline library part");
+	}
+
+	VkPipeline libraryPart;
+	VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &libraryPart);
+
+	if (shaderModule != VK_NULL_HANDLE)
+	{
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("faild to create a graphics pipeline library!");
+	}
+
+	return libraryPart;
+}
+
+VkShaderModule PipelineRegistry::createShaderModule(const ByteSpan& code)
+{
+	// shader module creation information
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = code.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); //reinterpret_cast converts between pointers (of different types)
+
+	VkShaderModule shaderModule;
+	VkResult result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create a shader module");
+	}
+
+	return shaderModule;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "EmbeddedShaders.h"
+#include "MappedFile.h"
+#include "Utilities.h"
+
+const uint32_t MAX_PIPELINE_VERTEX_ATTRIBUTES = 8;
+
+// hash of a PipelineState (shader code + fixed function state), 0 is never used as a key
+typedef uint64_t PipelineKey;
+
+// what a draw does while its pipeline is still being compiled (or failed to compile)
+enum PipelineFallback {
+	PIPELINE_FALLBACK_DEFAULT,		// draw with the renderer's default pipeline
+	PIPELINE_FALLBACK_SKIP,			// don't draw at all
+};
+
+// fragment shader paths switched by specialization constants (constant_id = bit index in shader.frag)
+// paths that are off are compiled out by the driver when the pipeline is created
+enum ShaderFeatureFlagBits {
+	SHADER_FEATURE_TEXTURE_BIT = 0x00000001,			// sample the mesh texture (otherwise white)
+	SHADER_FEATURE_VERTEX_COLOR_BIT = 0x00000002,		// multiply by the vertex color
+};
+typedef uint32_t ShaderFeatureFlags;
+const uint32_t SHADER_FEATURE_COUNT = 2;
+
+// everything a graphics pipeline is built from, apart from layout and render pass (shared by all pipelines of a registry)
+// viewport and scissor are dynamic state, so pipelines don't depend on the swapchain size
+struct PipelineState {
+	std::string vertexShader;			// SPIR-V files (embedded code is used instead if it was compiled in)
+	std::string fragmentShader;
+	ShaderFeatureFlags shaderFeatures;	// specialization of the fragment shader
+
+	// vertex layout, one interleaved binding
+	uint32_t vertexStride;
+	uint32_t vertexAttributeCount;
+	VkVertexInputAttributeDescription vertexAttributes[MAX_PIPELINE_VERTEX_ATTRIBUTES];
+
+	// input assembly + rasterizer
+	VkPrimitiveTopology topology;
+	VkPolygonMode polygonMode;
+	VkCullModeFlags cullMode;
+	VkFrontFace frontFace;
+
+	// blending of the single color attachment
+	VkBool32 blendEnable;
+	VkBlendFactor srcColorBlendFactor;
+	VkBlendFactor dstColorBlendFactor;
+	VkBlendOp colorBlendOp;
+	VkBlendFactor srcAlphaBlendFactor;
+	VkBlendFactor dstAlphaBlendFactor;
+	VkBlendOp alphaBlendOp;
+
+	// depth
+	VkBool32 depthTestEnable;
+	VkBool32 depthWriteEnable;
+	VkCompareOp depthCompareOp;
+};
+
+// the four VK_EXT_graphics_pipeline_library parts a pipeline is linked from
+enum PipelineLibraryPart {
+	PIPELINE_LIBRARY_VERTEX_INPUT,				// vertex layout + topology
+	PIPELINE_LIBRARY_PRE_RASTERIZATION,		// vertex shader, rasterizer, viewport
+	PIPELINE_LIBRARY_FRAGMENT_SHADER,			// fragment shader + its specialization, depth test
+	PIPELINE_LIBRARY_FRAGMENT_OUTPUT,			// blending
+	PIPELINE_LIBRARY_PART_COUNT
+};
+
+// state of the renderer's original pipeline: Vertex layout, Shaders/vert.spv + frag.spv, back face culling, alpha blending, depth less
+PipelineState createDefaultPipelineState();
+
+// pipelines looked up by a hash of their state, compiled on worker threads so a new variant never stalls the frame loop
+// with graphics pipeline libraries every part is built (and cached) on its own, a new variant is a quick link of
+// mostly existing parts, followed by a link time optimized relink in the background that replaces it once done
+// without the extension whole pipelines are compiled instead
+// request(), get() and wait() must be called from the thread that records commands, only compiles run on the workers
+class PipelineRegistry
+{
+public:
+	PipelineRegistry();
+
+	// newUseLibraries : VK_EXT_graphics_pipeline_library is enabled on the device
+	void init(VkDevice newDevice, VkPipelineCache newPipelineCache, VkPipelineLayout newPipelineLayout, VkRenderPass newRenderPass, uint32_t workerCount, bool newUseLibraries);
+
+	// key of the pipeline for state, queues a compile if it hasn't been requested before (shader files are read here)
+	PipelineKey request(const PipelineState& state);
+
+	// compiled pipeline (the optimized one once relinked), or VK_NULL_HANDLE while it's still compiling or if compiling failed
+	VkPipeline get(PipelineKey key);
+
+	// the pipeline is still being compiled (false once it's ready or failed, and for unknown keys)
+	bool isPending(PipelineKey key);
+
+	// block until the pipeline is compiled, throws std::runtime_error if compiling failed
+	VkPipeline wait(PipelineKey key);
+
+	// stop the workers (dropping queued compiles) and destroy every pipeline
+	void destroy();
+
+private:
+	enum PipelineStatus {
+		PIPELINE_STATUS_PENDING,
+		PIPELINE_STATUS_READY,
+		PIPELINE_STATUS_FAILED,
+	};
+
+	struct PipelineEntry {
+		PipelineState state;
+		const ByteSpan* vertexShaderCode;
+		const ByteSpan* fragmentShaderCode;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::atomic<int> status;		// pipeline may only be read once this is READY
+		VkPipeline optimizedPipeline = VK_NULL_HANDLE;
+		std::atomic<bool> optimized;	// optimizedPipeline may only be read once this is set
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	bool useLibraries = false;
+
+	std::unordered_map<PipelineKey, std::unique_ptr<PipelineEntry>> entries;
+	std::map<std::string, ByteSpan> shaderCode;				// SPIR-V by file name, mapped (or taken from the embedded code) once
+	std::map<std::string, MappedFile> shaderFiles;			// mappings the spans of shaders that aren't embedded point into
+
+	// compile queue
+	std::vector<std::thread> workers;
+	std::deque<PipelineEntry*> jobs;
+	std::deque<PipelineEntry*> relinkJobs;		// link time optimization of pipelines that already work
+	std::mutex jobMutex;
+	std::condition_variable jobCondition;		// new job or stopping
+	std::condition_variable doneCondition;		// a compile finished (for wait())
+	bool stopping = false;
+
+	// library parts by hash of the state they were built from
+	std::unordered_map<uint64_t, VkPipeline> libraryParts[PIPELINE_LIBRARY_PART_COUNT];
+	std::mutex libraryMutex;
+
+	const ByteSpan& getShaderCode(const std::string& fileName);
+	PipelineKey hashState(const PipelineState& state, const ByteSpan& vertexCode, const ByteSpan& fragmentCode);
+
+	void workerLoop();
+	VkPipeline compilePipeline(const PipelineEntry& entry);
+	VkPipeline linkPipeline(const PipelineEntry& entry, bool optimize);
+	VkPipeline getLibraryPart(PipelineLibraryPart part, uint64_t partKey, const PipelineEntry& entry);
+	VkPipeline createLibraryPart(PipelineLibraryPart part, const PipelineEntry& entry);
+	VkShaderModule createShaderModule(const ByteSpan& code);
+};
@@ -0,0 +1,135 @@
+#include "QueueTimeline.h"
+
+#include <limits>
+#include <stdexcept>
+
+QueueTimeline::QueueTimeline()
+{
+}
+
+void QueueTimeline::create(VkDevice newDevice, VkQueue newQueue)
+{
+	device = newDevice;
+	queue = newQueue;
+	lastValue = 0;
+
+	VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+	semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+	if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Faild to create a timeline semaphore");
+	}
+}
+
+uint64_t QueueTimeline::submit(const TimelineSubmit& timelineSubmit)
+{
+	// wait list: binary semaphore and/or other timeline (values of binary semaphores are ignored)
+	VkSemaphore waitSemaphores[2];
+	VkPipelineStageFlags waitStages[2];
+	uint64_t waitValues[2];
+	uint32_t waitCount = 0;
+
+	if (timelineSubmit.waitSemaphore != VK_NULL_HANDLE)
+	{
+		waitSemaphores[waitCount] = timelineSubmit.waitSemaphore;
+		waitStages[waitCount] = timelineSubmit.waitStage;
+		waitValues[waitCount] = 0;
+		waitCount++;
+	}
+	if (timelineSubmit.waitTimeline != nullptr)
+	{
+		waitSemaphores[waitCount] = timelineSubmit.waitTimeline->getSemaphore();
+		waitStages[waitCount] = timelineSubmit.waitTimelineStage;
+		waitValues[waitCount] = timelineSubmit.waitValue;
+		waitCount++;
+	}
+
+	// signal list: this timeline + optional binary semaphore
+	VkSemaphore signalSemaphores[2] = { semaphore, timelineSubmit.signalSemaphore };
+	uint64_t signalValues[2] = { 0, 0 };
+	uint32_t signalCount = timelineSubmit.signalSemaphore != VK_NULL_HANDLE ? 2 : 1;
+
+	std::lock_guard<std::mutex> lock(submitMutex);
+
+	signalValues[0] = lastValue + 1;
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.waitSemaphoreValueCount = waitCount;
+	timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+	timelineSubmitInfo.signalSemaphoreValueCount = signalCount;
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineSubmitInfo;
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.commandBufferCount = timelineSubmit.commandBufferCount;
+	submitInfo.pCommandBuffers = timelineSubmit.pCommandBuffers;
+	submitInfo.signalSemaphoreCount = signalCount;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	VkResult result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("faild to submid command buffer to queue");
+	}
+
+	// only counts once the submission went through
+	lastValue = signalValues[0];
+	return lastValue;
+}
+
+uint64_t QueueTimeline::getLastValue()
+{
+	std::lock_guard<std::mutex> lock(submitMutex);
+	return lastValue;
+}
+
+uint64_t QueueTimeline::getCompletedValue()
+{
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(device, semaphore, &value);
+	return value;
+}
+
+void QueueTimeline::wait(uint64_t value)
+{
+	if (value == 0)
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+
+	vkWaitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max());
+}
+
+VkSemaphore QueueTimeline::getSemaphore() const
+{
+	return semaphore;
+}
+
+VkQueue QueueTimeline::getQueue() const
+{
+	return queue;
+}
+
+void QueueTimeline::destroy()
+{
+	vkDestroySemaphore(device, semaphore, nullptr);
+	semaphore = VK_NULL_HANDLE;
+}
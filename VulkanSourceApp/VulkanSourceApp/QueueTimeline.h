@@ -0,0 +1,62 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+
+class QueueTimeline;
+
+// one submission through a QueueTimeline, everything but the command buffers is optional
+struct TimelineSubmit {
+	uint32_t commandBufferCount = 0;
+	const VkCommandBuffer* pCommandBuffers = nullptr;
+
+	// binary semaphore to wait for (swapchain acquire) and stage the wait happens at
+	VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+	VkPipelineStageFlags waitStage = 0;
+
+	// value of another queue's timeline to wait for (cross queue dependency, no extra binary semaphore needed)
+	const QueueTimeline* waitTimeline = nullptr;
+	uint64_t waitValue = 0;
+	VkPipelineStageFlags waitTimelineStage = 0;
+
+	// binary semaphore to signal on completion (presentation can't wait on timeline semaphores)
+	VkSemaphore signalSemaphore = VK_NULL_HANDLE;
+};
+
+// a timeline semaphore owned by a queue: every submission through it signals the next value,
+// so "has submission N finished" is a counter compare and CPU waits are "wait until value N"
+// (replaces per frame fences and vkQueueWaitIdle, values also tell when resources used by a submission can be freed)
+class QueueTimeline
+{
+public:
+	QueueTimeline();
+
+	void create(VkDevice newDevice, VkQueue newQueue);
+
+	// submit and signal the next value, returns that value (safe to call from several threads, the queue is locked)
+	uint64_t submit(const TimelineSubmit& timelineSubmit);
+
+	// value of the last submission (waiting for it waits for everything submitted so far)
+	uint64_t getLastValue();
+
+	// highest value the GPU has finished
+	uint64_t getCompletedValue();
+
+	// block until value has been reached (0 returns at once)
+	void wait(uint64_t value);
+
+	VkSemaphore getSemaphore() const;
+	VkQueue getQueue() const;
+
+	void destroy();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+
+	std::mutex submitMutex;				// values must be signalled in the order they're handed out
+	uint64_t lastValue = 0;
+};
@@ -0,0 +1,1302 @@
+#include "SceneLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "Json.h"
+#include "MappedFile.h"
+#include "stb_image.h"
+
+// -- THREADING --
+
+// run body(0..count-1) on the job system's workers, or without one on up to hardware_concurrency threads of its own
+// rethrows the first exception on the calling thread
+static void parallelFor(JobSystem* jobSystem, size_t count, const std::function<void(size_t)>& body)
+{
+	if (jobSystem)
+	{
+		// one task per job, tasks are whole files and images
+		jobSystem->parallelFor(count, 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				body(i);
+			}
+		});
+		return;
+	}
+
+	size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+	if (threadCount <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			body(i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto worker = [&]() {
+		size_t i;
+		while ((i = next++) < count)
+		{
+			try {
+				body(i);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error)
+				{
+					error = std::current_exception();
+				}
+				next = count;		// stop handing out work
+			}
+		}
+	};
+
+	// calling thread works too
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < threadCount; t++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+// -- FILES --
+
+// mapped instead of read, parsers and decoders work on the page cache directly
+static MappedFile readSceneFile(const std::string& fileName)
+{
+	MappedFile file;
+	if (!file.open(fileName))
+	{
+		throw std::runtime_error("Failed to open scene file! (" + fileName + ")");
+	}
+	return file;
+}
+
+static std::string directoryOf(const std::string& fileName)
+{
+	size_t slash = fileName.find_last_of("/\\");
+	return slash == std::string::npos ? "" : fileName.substr(0, slash + 1);
+}
+
+static std::string extensionOf(const std::string& fileName)
+{
+	size_t dot = fileName.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : fileName.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(tolower(c)); });
+	return extension;
+}
+
+// uris in glTF are percent-encoded (e.g. spaces as %20)
+static std::string decodeUri(const std::string& uri)
+{
+	std::string result;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size())
+		{
+			result += char(strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+			i += 2;
+		}
+		else
+		{
+			result += uri[i];
+		}
+	}
+	return result;
+}
+
+static std::vector<char> decodeBase64(const char* text, size_t length)
+{
+	static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	int lookup[256];
+	std::fill(lookup, lookup + 256, -1);
+	for (int i = 0; i < 64; i++)
+	{
+		lookup[(unsigned char)alphabet[i]] = i;
+	}
+
+	std::vector<char> result;
+	result.reserve(length / 4 * 3);
+
+	uint32_t bits = 0;
+	int bitCount = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		int value = lookup[(unsigned char)text[i]];
+		if (value < 0)
+		{
+			continue;		// padding / whitespace
+		}
+
+		bits = (bits << 6) | value;
+		bitCount += 6;
+		if (bitCount >= 8)
+		{
+			bitCount -= 8;
+			result.push_back(char((bits >> bitCount) & 0xFF));
+		}
+	}
+
+	return result;
+}
+
+// -- IMAGES --
+
+static void decodeImage(const stbi_uc* data, size_t size, const std::string& name, SceneImage* image)
+{
+	int channels;
+	stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(size), &image->width, &image->height, &channels, STBI_rgb_alpha);
+	if (!pixels)
+	{
+		throw std::runtime_error("Failed to decode a scene image! (" + name + ")");
+	}
+
+	image->pixels.assign(pixels, pixels + size_t(image->width) * image->height * 4);
+	stbi_image_free(pixels);
+}
+
+static void decodeImageFile(const std::string& fileName, SceneImage* image)
+{
+	MappedFile file = readSceneFile(fileName);
+	decodeImage(reinterpret_cast<const stbi_uc*>(file.data()), file.size(), fileName, image);
+}
+
+// 1x1 image of a color, shared between all materials with that color
+static int solidColorImage(SceneData& scene, std::unordered_map<uint32_t, int>& solidImages, const glm::vec4& color)
+{
+	unsigned char rgba[4];
+	for (int c = 0; c < 4; c++)
+	{
+		rgba[c] = static_cast<unsigned char>(glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	uint32_t key;
+	memcpy(&key, rgba, 4);
+
+	auto found = solidImages.find(key);
+	if (found != solidImages.end())
+	{
+		return found->second;
+	}
+
+	SceneImage image;
+	image.width = 1;
+	image.height = 1;
+	image.pixels.assign(rgba, rgba + 4);
+	scene.images.push_back(std::move(image));
+
+	int index = static_cast<int>(scene.images.size()) - 1;
+	solidImages[key] = index;
+	return index;
+}
+
+// -- GLTF --
+
+const uint32_t GLB_MAGIC = 0x46546C67;			// "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;	// "JSON"
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;		// "BIN\0"
+
+enum GltfComponentType {
+	GLTF_BYTE = 5120,
+	GLTF_UNSIGNED_BYTE = 5121,
+	GLTF_SHORT = 5122,
+	GLTF_UNSIGNED_SHORT = 5123,
+	GLTF_UNSIGNED_INT = 5125,
+	GLTF_FLOAT = 5126
+};
+
+enum GltfPrimitiveMode {
+	GLTF_TRIANGLES = 4,
+	GLTF_TRIANGLE_STRIP = 5,
+	GLTF_TRIANGLE_FAN = 6
+};
+
+// resolved accessor: where element i starts is data + i * stride
+struct GltfAccessor {
+	const unsigned char* data = nullptr;		// nullptr means all zero (accessor without bufferView)
+	size_t count = 0;
+	size_t stride = 0;
+	int componentType = GLTF_FLOAT;
+	int components = 1;
+	bool normalized = false;
+};
+
+static int gltfComponentSize(int componentType)
+{
+	switch (componentType)
+	{
+	case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+	case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+	case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+	default: throw std::runtime_error("Unsupported glTF component type");
+	}
+}
+
+static int gltfComponentCount(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT4") return 16;
+	throw std::runtime_error("Unsupported glTF accessor type (" + type + ")");
+}
+
+// top level array of the document (accessors, bufferViews, ...), element index checked
+static const JsonValue& gltfElement(const JsonValue& document, const char* arrayName, int index)
+{
+	const JsonValue* list = document.find(arrayName);
+	if (!list || index < 0 || index >= static_cast<int>(list->size()))
+	{
+		throw std::runtime_error(std::string("glTF references a missing element of ") + arrayName);
+	}
+	return (*list)[index];
+}
+
+static GltfAccessor resolveAccessor(const JsonValue& document, const std::vector<ByteSpan>& buffers, int accessorIndex)
+{
+	const JsonValue& accessor = gltfElement(document, "accessors", accessorIndex);
+
+	GltfAccessor result;
+	result.count = static_cast<size_t>(accessor.getNumber("count"));
+	result.componentType = accessor.getInt("componentType", GLTF_FLOAT);
+	result.components = gltfComponentCount(accessor.getString("type", "SCALAR"));
+	result.normalized = accessor.getBool("normalized");
+	result.stride = size_t(gltfComponentSize(result.componentType)) * result.components;
+
+	if (accessor.find("sparse"))
+	{
+		printf("WARNING: sparse glTF accessors are not supported, using the base values only\n");
+	}
+
+	int viewIndex = accessor.getInt("bufferView");
+	if (viewIndex < 0)
+	{
+		return result;
+	}
+
+	const JsonValue& view = gltfElement(document, "bufferViews", viewIndex);
+	const ByteSpan& buffer = buffers.at(view.getInt("buffer", 0));
+
+	size_t offset = static_cast<size_t>(view.getNumber("byteOffset") + accessor.getNumber("byteOffset"));
+	size_t viewStride = static_cast<size_t>(view.getNumber("byteStride"));
+	if (viewStride != 0)
+	{
+		result.stride = viewStride;
+	}
+
+	size_t elementSize = size_t(gltfComponentSize(result.componentType)) * result.components;
+	if (result.count > 0 && offset + (result.count - 1) * result.stride + elementSize > buffer.size())
+	{
+		throw std::runtime_error("glTF accessor reads past the end of its buffer");
+	}
+
+	result.data = reinterpret_cast<const unsigned char*>(buffer.data()) + offset;
+	return result;
+}
+
+// convert up to dstComponents components of every element to float and write them dstStride bytes apart
+// one tight loop per source type, so the float case is a strided copy and the integer cases vectorize
+template <typename T>
+static void convertAccessor(const GltfAccessor& accessor, int dstComponents, float scale, unsigned char* dst, size_t dstStride)
+{
+	int components = std::min(accessor.components, dstComponents);
+	for (size_t i = 0; i < accessor.count; i++)
+	{
+		const unsigned char* src = accessor.data + i * accessor.stride;
+		float* out = reinterpret_cast<float*>(dst + i * dstStride);
+		for (int c = 0; c < components; c++)
+		{
+			T value;
+			memcpy(&value, src + c * sizeof(T), sizeof(T));
+			out[c] = float(value) * scale;
+		}
+	}
+}
+
+static void readAccessorFloats(const GltfAccessor& accessor, int dstComponents, unsigned char* dst, size_t dstStride)
+{
+	if (!accessor.data)
+	{
+		return;
+	}
+
+	// normalized integers map to [0, 1] (unsigned) or [-1, 1] (signed, clamped below)
+	bool normalized = accessor.normalized;
+	switch (accessor.componentType)
+	{
+	case GLTF_FLOAT:					convertAccessor<float>(accessor, dstComponents, 1.0f, dst, dstStride); break;
+	case GLTF_UNSIGNED_BYTE:		convertAccessor<uint8_t>(accessor, dstComponents, normalized ? 1.0f / 255.0f : 1.0f, dst, dstStride); break;
+	case GLTF_UNSIGNED_SHORT:	convertAccessor<uint16_t>(accessor, dstComponents, normalized ? 1.0f / 65535.0f : 1.0f, dst, dstStride); break;
+	case GLTF_BYTE:					convertAccessor<int8_t>(accessor, dstComponents, normalized ? 1.0f / 127.0f : 1.0f, dst, dstStride); break;
+	case GLTF_SHORT:					convertAccessor<int16_t>(accessor, dstComponents, normalized ? 1.0f / 32767.0f : 1.0f, dst, dstStride); break;
+	default: throw std::runtime_error("Unsupported glTF vertex attribute component type");
+	}
+
+	if (normalized && (accessor.componentType == GLTF_BYTE || accessor.componentType == GLTF_SHORT))
+	{
+		int components = std::min(accessor.components, dstComponents);
+		for (size_t i = 0; i < accessor.count; i++)
+		{
+			float* out = reinterpret_cast<float*>(dst + i * dstStride);
+			for (int c = 0; c < components; c++)
+			{
+				out[c] = std::max(out[c], -1.0f);
+			}
+		}
+	}
+}
+
+static std::vector<uint32_t> readAccessorIndices(const GltfAccessor& accessor)
+{
+	std::vector<uint32_t> indices(accessor.count, 0);
+	if (!accessor.data)
+	{
+		return indices;
+	}
+
+	for (size_t i = 0; i < accessor.count; i++)
+	{
+		const unsigned char* src = accessor.data + i * accessor.stride;
+		switch (accessor.componentType)
+		{
+		case GLTF_UNSIGNED_BYTE:		indices[i] = *src; break;
+		case GLTF_UNSIGNED_SHORT:	{ uint16_t value; memcpy(&value, src, 2); indices[i] = value; break; }
+		case GLTF_UNSIGNED_INT:		memcpy(&indices[i], src, 4); break;
+		default: throw std::runtime_error("Unsupported glTF index component type");
+		}
+	}
+
+	return indices;
+}
+
+// strips and fans become plain triangle lists, the renderer only draws lists
+static std::vector<uint32_t> triangulate(const std::vector<uint32_t>& indices, int mode)
+{
+	if (mode == GLTF_TRIANGLES)
+	{
+		return indices;
+	}
+
+	std::vector<uint32_t> result;
+	for (size_t i = 2; i < indices.size(); i++)
+	{
+		if (mode == GLTF_TRIANGLE_STRIP)
+		{
+			// every other triangle of a strip is wound the other way
+			bool odd = (i % 2) == 1;
+			result.push_back(indices[i - 2]);
+			result.push_back(indices[odd ? i : i - 1]);
+			result.push_back(indices[odd ? i - 1 : i]);
+		}
+		else
+		{
+			result.push_back(indices[0]);
+			result.push_back(indices[i - 1]);
+			result.push_back(indices[i]);
+		}
+	}
+	return result;
+}
+
+static void convertPrimitive(const JsonValue& document, const std::vector<ByteSpan>& buffers, const JsonValue& primitive, SceneMesh* mesh)
+{
+	const JsonValue* attributes = primitive.find("attributes");
+	int positionAccessor = attributes ? attributes->getInt("POSITION") : -1;
+	if (positionAccessor < 0)
+	{
+		return;
+	}
+
+	GltfAccessor positions = resolveAccessor(document, buffers, positionAccessor);
+
+	// defaults for attributes the primitive doesn't have
+	Vertex defaultVertex = {};
+	defaultVertex.col = glm::vec3(1.0f, 1.0f, 1.0f);
+	mesh->vertices.assign(positions.count, defaultVertex);
+
+	unsigned char* base = reinterpret_cast<unsigned char*>(mesh->vertices.data());
+	readAccessorFloats(positions, 3, base + offsetof(Vertex, pos), sizeof(Vertex));
+
+	int colorAccessor = attributes->getInt("COLOR_0");
+	if (colorAccessor >= 0)
+	{
+		readAccessorFloats(resolveAccessor(document, buffers, colorAccessor), 3, base + offsetof(Vertex, col), sizeof(Vertex));
+	}
+
+	int texCoordAccessor = attributes->getInt("TEXCOORD_0");
+	if (texCoordAccessor >= 0)
+	{
+		readAccessorFloats(resolveAccessor(document, buffers, texCoordAccessor), 2, base + offsetof(Vertex, tex), sizeof(Vertex));
+	}
+
+	// non-indexed primitives draw vertices in order
+	std::vector<uint32_t> indices;
+	int indexAccessor = primitive.getInt("indices");
+	if (indexAccessor >= 0)
+	{
+		indices = readAccessorIndices(resolveAccessor(document, buffers, indexAccessor));
+	}
+	else
+	{
+		indices.resize(positions.count);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			indices[i] = static_cast<uint32_t>(i);
+		}
+	}
+
+	mesh->indices = triangulate(indices, primitive.getInt("mode", GLTF_TRIANGLES));
+
+	for (uint32_t index : mesh->indices)
+	{
+		if (index >= mesh->vertices.size())
+		{
+			throw std::runtime_error("glTF index out of range");
+		}
+	}
+}
+
+static glm::mat4 nodeTransform(const JsonValue& node)
+{
+	glm::mat4 transform(1.0f);
+
+	const JsonValue* matrix = node.find("matrix");
+	if (matrix && matrix->size() == 16)
+	{
+		// glTF matrices are column major like glm
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				transform[column][row] = float((*matrix)[column * 4 + row].number);
+			}
+		}
+		return transform;
+	}
+
+	// T * R * S
+	glm::vec3 translation(0.0f);
+	glm::vec4 rotation(0.0f, 0.0f, 0.0f, 1.0f);		// quaternion (x, y, z, w)
+	glm::vec3 scale(1.0f);
+
+	const JsonValue* value;
+	if ((value = node.find("translation")) && value->size() == 3)
+	{
+		translation = glm::vec3(float((*value)[0].number), float((*value)[1].number), float((*value)[2].number));
+	}
+	if ((value = node.find("rotation")) && value->size() == 4)
+	{
+		rotation = glm::vec4(float((*value)[0].number), float((*value)[1].number), float((*value)[2].number), float((*value)[3].number));
+	}
+	if ((value = node.find("scale")) && value->size() == 3)
+	{
+		scale = glm::vec3(float((*value)[0].number), float((*value)[1].number), float((*value)[2].number));
+	}
+
+	float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+	transform[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f) * scale.x;
+	transform[1] = glm::vec4(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f) * scale.y;
+	transform[2] = glm::vec4(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f) * scale.z;
+	transform[3] = glm::vec4(translation, 1.0f);
+
+	return transform;
+}
+
+static void addNodeInstances(const JsonValue& document, const std::vector<std::vector<int>>& meshPrimitives, int nodeIndex,
+	const glm::mat4& parentTransform, int depth, SceneData& scene)
+{
+	const JsonValue* nodes = document.find("nodes");
+	if (!nodes || nodeIndex < 0 || nodeIndex >= static_cast<int>(nodes->size()) || depth > 64)
+	{
+		return;
+	}
+
+	const JsonValue& node = (*nodes)[nodeIndex];
+	glm::mat4 transform = parentTransform * nodeTransform(node);
+
+	int meshIndex = node.getInt("mesh");
+	if (meshIndex >= 0 && meshIndex < static_cast<int>(meshPrimitives.size()))
+	{
+		for (int primitive : meshPrimitives[meshIndex])
+		{
+			scene.instances.push_back({ primitive, transform });
+		}
+	}
+
+	const JsonValue* children = node.find("children");
+	if (children)
+	{
+		for (const JsonValue& child : children->array)
+		{
+			addNodeInstances(document, meshPrimitives, static_cast<int>(child.number), transform, depth + 1, scene);
+		}
+	}
+}
+
+static SceneData loadGltf(const std::string& fileName, JobSystem* jobSystem)
+{
+	MappedFile file = readSceneFile(fileName);
+	std::string directory = directoryOf(fileName);
+
+	// .glb is a small header, a JSON chunk and an optional binary chunk
+	const char* jsonText = file.data();
+	size_t jsonLength = file.size();
+	ByteSpan glbBinary;		// points into file
+
+	uint32_t magic = 0;
+	if (file.size() >= 12)
+	{
+		memcpy(&magic, file.data(), 4);
+	}
+
+	if (magic == GLB_MAGIC)
+	{
+		jsonText = nullptr;
+		size_t offset = 12;
+		while (offset + 8 <= file.size())
+		{
+			uint32_t chunkLength, chunkType;
+			memcpy(&chunkLength, file.data() + offset, 4);
+			memcpy(&chunkType, file.data() + offset + 4, 4);
+			offset += 8;
+
+			if (offset + chunkLength > file.size())
+			{
+				throw std::runtime_error("Truncated glb file! (" + fileName + ")");
+			}
+
+			if (chunkType == GLB_CHUNK_JSON && !jsonText)
+			{
+				jsonText = file.data() + offset;
+				jsonLength = chunkLength;
+			}
+			else if (chunkType == GLB_CHUNK_BIN && glbBinary.empty())
+			{
+				glbBinary = ByteSpan(file.data() + offset, chunkLength);
+			}
+
+			offset += chunkLength;
+		}
+
+		if (!jsonText)
+		{
+			throw std::runtime_error("glb file has no JSON chunk! (" + fileName + ")");
+		}
+	}
+
+	JsonValue document = parseJson(jsonText, jsonLength);
+
+	// -- BUFFERS --
+	// external .bin files are mapped in parallel, accessors read them (and the glb binary chunk) in place
+	const JsonValue* bufferList = document.find("buffers");
+	size_t bufferCount = bufferList ? bufferList->size() : 0;
+	std::vector<ByteSpan> buffers(bufferCount);
+	std::vector<MappedFile> bufferFiles(bufferCount);
+	std::vector<std::vector<char>> decodedBuffers(bufferCount);		// data: uris
+
+	parallelFor(jobSystem, bufferCount, [&](size_t i) {
+		std::string uri = (*bufferList)[i].getString("uri");
+		if (uri.empty())
+		{
+			buffers[i] = glbBinary;
+		}
+		else if (uri.compare(0, 5, "data:") == 0)
+		{
+			size_t comma = uri.find(',');
+			decodedBuffers[i] = decodeBase64(uri.data() + comma + 1, uri.size() - comma - 1);
+			buffers[i] = ByteSpan(decodedBuffers[i].data(), decodedBuffers[i].size());
+		}
+		else
+		{
+			bufferFiles[i] = readSceneFile(directory + decodeUri(uri));
+			buffers[i] = bufferFiles[i].span();
+		}
+	});
+
+	SceneData scene;
+
+	// -- IMAGES --
+	const JsonValue* imageList = document.find("images");
+	size_t imageCount = imageList ? imageList->size() : 0;
+	scene.images.resize(imageCount);
+
+	// -- MESHES --
+	// every primitive becomes one SceneMesh, since each can have its own material
+	struct PrimitiveTask {
+		const JsonValue* primitive;
+		int meshIndex;
+	};
+	std::vector<PrimitiveTask> primitiveTasks;
+	std::vector<std::vector<int>> meshPrimitives;
+
+	const JsonValue* meshList = document.find("meshes");
+	for (size_t m = 0; meshList && m < meshList->size(); m++)
+	{
+		meshPrimitives.emplace_back();
+		const JsonValue* primitives = (*meshList)[m].find("primitives");
+		for (size_t p = 0; primitives && p < primitives->size(); p++)
+		{
+			meshPrimitives.back().push_back(static_cast<int>(primitiveTasks.size()));
+			primitiveTasks.push_back({ &(*primitives)[p], static_cast<int>(m) });
+		}
+	}
+	scene.meshes.resize(primitiveTasks.size());
+
+	// decode images and convert primitives in one go, both are independent of each other
+	parallelFor(jobSystem, imageCount + primitiveTasks.size(), [&](size_t task) {
+		if (task < imageCount)
+		{
+			const JsonValue& image = (*imageList)[task];
+			std::string uri = image.getString("uri");
+			int viewIndex = image.getInt("bufferView");
+
+			if (viewIndex >= 0)
+			{
+				const JsonValue& view = gltfElement(document, "bufferViews", viewIndex);
+				const ByteSpan& buffer = buffers.at(view.getInt("buffer", 0));
+				size_t offset = static_cast<size_t>(view.getNumber("byteOffset"));
+				size_t length = static_cast<size_t>(view.getNumber("byteLength"));
+				if (offset + length > buffer.size())
+				{
+					throw std::runtime_error("glTF image reads past the end of its buffer");
+				}
+				decodeImage(reinterpret_cast<const stbi_uc*>(buffer.data()) + offset, length, fileName, &scene.images[task]);
+			}
+			else if (uri.compare(0, 5, "data:") == 0)
+			{
+				size_t comma = uri.find(',');
+				std::vector<char> data = decodeBase64(uri.data() + comma + 1, uri.size() - comma - 1);
+				decodeImage(reinterpret_cast<const stbi_uc*>(data.data()), data.size(), fileName, &scene.images[task]);
+			}
+			else
+			{
+				decodeImageFile(directory + decodeUri(uri), &scene.images[task]);
+			}
+		}
+		else
+		{
+			size_t primitive = task - imageCount;
+			convertPrimitive(document, buffers, *primitiveTasks[primitive].primitive, &scene.meshes[primitive]);
+		}
+	});
+
+	// -- MATERIALS --
+	// base color texture if there is one, otherwise a 1x1 image of the base color factor
+	std::unordered_map<uint32_t, int> solidImages;
+	const JsonValue* materials = document.find("materials");
+	const JsonValue* textures = document.find("textures");
+
+	for (size_t i = 0; i < primitiveTasks.size(); i++)
+	{
+		int materialIndex = primitiveTasks[i].primitive->getInt("material");
+		glm::vec4 baseColor(1.0f, 1.0f, 1.0f, 1.0f);
+		int imageIndex = -1;
+
+		if (materials && materialIndex >= 0 && materialIndex < static_cast<int>(materials->size()))
+		{
+			const JsonValue* pbr = (*materials)[materialIndex].find("pbrMetallicRoughness");
+			const JsonValue* factor = pbr ? pbr->find("baseColorFactor") : nullptr;
+			if (factor && factor->size() == 4)
+			{
+				baseColor = glm::vec4(float((*factor)[0].number), float((*factor)[1].number), float((*factor)[2].number), float((*factor)[3].number));
+			}
+
+			const JsonValue* baseColorTexture = pbr ? pbr->find("baseColorTexture") : nullptr;
+			int textureIndex = baseColorTexture ? baseColorTexture->getInt("index") : -1;
+			if (textures && textureIndex >= 0 && textureIndex < static_cast<int>(textures->size()))
+			{
+				imageIndex = (*textures)[textureIndex].getInt("source");
+			}
+		}
+
+		scene.meshes[i].imageIndex = imageIndex >= 0 && imageIndex < static_cast<int>(imageCount) ? imageIndex : solidColorImage(scene, solidImages, baseColor);
+	}
+
+	// -- NODES --
+	// place primitives through the node hierarchy of the default scene
+	const JsonValue* scenes = document.find("scenes");
+	if (scenes && scenes->size() > 0)
+	{
+		int sceneIndex = std::max(0, std::min(document.getInt("scene", 0), static_cast<int>(scenes->size()) - 1));
+		const JsonValue* rootNodes = (*scenes)[sceneIndex].find("nodes");
+		for (size_t i = 0; rootNodes && i < rootNodes->size(); i++)
+		{
+			addNodeInstances(document, meshPrimitives, static_cast<int>((*rootNodes)[i].number), glm::mat4(1.0f), 0, scene);
+		}
+	}
+	else
+	{
+		// no scene description, show every mesh once
+		for (size_t i = 0; i < scene.meshes.size(); i++)
+		{
+			scene.instances.push_back({ static_cast<int>(i), glm::mat4(1.0f) });
+		}
+	}
+
+	return scene;
+}
+
+// -- OBJ --
+
+const uint32_t OBJ_CORNER_POSITION_RELATIVE = 0x1;
+const uint32_t OBJ_CORNER_TEXCOORD_RELATIVE = 0x2;
+
+// corner of a face, 0-based indices that are either global or (for negative OBJ indices) relative to the start of the chunk they were read in
+struct ObjCorner {
+	int position;
+	int texCoord;				// INT_MAX if the corner has none
+	uint32_t relativeFlags;	// OBJ_CORNER_*_RELATIVE, resolved once all chunks are parsed
+};
+
+// material switch at a corner offset inside a chunk
+struct ObjMaterialSwitch {
+	size_t cornerOffset;
+	std::string material;
+};
+
+struct ObjChunk {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> colors;				// only filled if the file uses "v x y z r g b"
+	std::vector<glm::vec2> texCoords;
+	std::vector<ObjCorner> corners;				// triangulated, 3 per triangle
+	std::vector<ObjMaterialSwitch> materialSwitches;
+	std::vector<std::string> materialLibraries;
+};
+
+struct ObjMaterial {
+	glm::vec3 diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	std::string diffuseMap;
+};
+
+static const char* skipSpaces(const char* c, const char* end)
+{
+	while (c < end && (*c == ' ' || *c == '\t'))
+	{
+		c++;
+	}
+	return c;
+}
+
+static const char* lineEnd(const char* c, const char* end)
+{
+	while (c < end && *c != '\n')
+	{
+		c++;
+	}
+	return c;
+}
+
+static std::string restOfLine(const char* c, const char* end)
+{
+	c = skipSpaces(c, end);
+	const char* stop = lineEnd(c, end);
+	while (stop > c && (stop[-1] == '\r' || stop[-1] == ' ' || stop[-1] == '\t'))
+	{
+		stop--;
+	}
+	return std::string(c, stop);
+}
+
+// the text isn't NUL terminated (a file without a line break at the end stops right at end), so nothing may look past end:
+// words are compared bounded, numbers are copied out before strtof()/strtol() see them
+
+static bool startsWith(const char* c, const char* end, const char* word)
+{
+	size_t length = strlen(word);
+	return size_t(end - c) >= length && memcmp(c, word, length) == 0;
+}
+
+// copy of the number starting at c (up to the next separator), terminated
+static size_t copyNumber(const char* c, const char* end, char* buffer, size_t bufferSize)
+{
+	size_t length = 0;
+	while (c + length < end && length + 1 < bufferSize && c[length] != ' ' && c[length] != '\t' && c[length] != '\n' && c[length] != '\r' && c[length] != '/')
+	{
+		length++;
+	}
+	memcpy(buffer, c, length);
+	buffer[length] = '\0';
+	return length;
+}
+
+// parse a number at c and move c past it, false (c unchanged) if there is none
+static bool parseFloat(const char*& c, const char* end, float* value)
+{
+	char buffer[64];
+	copyNumber(c, end, buffer, sizeof(buffer));
+
+	char* next;
+	*value = strtof(buffer, &next);
+	if (next == buffer)
+	{
+		return false;
+	}
+	c += next - buffer;
+	return true;
+}
+
+static bool parseLong(const char*& c, const char* end, long* value)
+{
+	char buffer[32];
+	copyNumber(c, end, buffer, sizeof(buffer));
+
+	char* next;
+	*value = strtol(buffer, &next, 10);
+	if (next == buffer)
+	{
+		return false;
+	}
+	c += next - buffer;
+	return true;
+}
+
+// read up to maxCount floats of the current line
+static int parseFloats(const char*& c, const char* end, float* values, int maxCount)
+{
+	int count = 0;
+	while (count < maxCount)
+	{
+		c = skipSpaces(c, end);
+		if (c >= end || *c == '\n' || *c == '\r')
+		{
+			break;
+		}
+
+		if (!parseFloat(c, end, &values[count]))
+		{
+			break;
+		}
+		count++;
+	}
+	return count;
+}
+
+// convert an OBJ index (1-based, or negative = counted back from the latest element) to 0-based
+// negative ones are relative to what this chunk read so far (possibly reaching into earlier chunks), the chunk's base is only known after all chunks are parsed
+static int decodeObjIndex(long index, size_t chunkCount, bool* relative)
+{
+	*relative = index < 0;
+	return index < 0 ? static_cast<int>(long(chunkCount) + index) : static_cast<int>(index - 1);
+}
+
+static void parseObjChunk(const char* begin, const char* end, ObjChunk* chunk)
+{
+	std::vector<ObjCorner> polygon;
+
+	for (const char* c = begin; c < end; c = lineEnd(c, end) + 1)
+	{
+		c = skipSpaces(c, end);
+		if (c + 1 >= end)
+		{
+			break;
+		}
+
+		if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			const char* p = c + 2;
+			float values[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+			int count = parseFloats(p, end, values, 6);
+
+			chunk->positions.push_back(glm::vec3(values[0], count > 1 ? values[1] : 0.0f, count > 2 ? values[2] : 0.0f));
+			if (count == 6)
+			{
+				// vertex colors, keep the color list aligned with positions
+				chunk->colors.resize(chunk->positions.size() - 1, glm::vec3(1.0f, 1.0f, 1.0f));
+				chunk->colors.push_back(glm::vec3(values[3], values[4], values[5]));
+			}
+		}
+		else if (c[0] == 'v' && c[1] == 't')
+		{
+			const char* p = c + 2;
+			float values[2] = { 0.0f, 0.0f };
+			parseFloats(p, end, values, 2);
+			chunk->texCoords.push_back(glm::vec2(values[0], values[1]));
+		}
+		else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			// "f v", "f v/vt", "f v//vn" or "f v/vt/vn", any number of corners
+			polygon.clear();
+			const char* p = c + 2;
+			while (true)
+			{
+				p = skipSpaces(p, end);
+				if (p >= end || *p == '\n' || *p == '\r')
+				{
+					break;
+				}
+
+				long position;
+				if (!parseLong(p, end, &position))
+				{
+					break;
+				}
+
+				bool relative;
+				ObjCorner corner = { decodeObjIndex(position, chunk->positions.size(), &relative), INT_MAX, 0 };
+				corner.relativeFlags |= relative ? OBJ_CORNER_POSITION_RELATIVE : 0;
+
+				if (p < end && *p == '/')
+				{
+					p++;
+					long texCoord;
+					if (parseLong(p, end, &texCoord))
+					{
+						corner.texCoord = decodeObjIndex(texCoord, chunk->texCoords.size(), &relative);
+						corner.relativeFlags |= relative ? OBJ_CORNER_TEXCOORD_RELATIVE : 0;
+					}
+					if (p < end && *p == '/')
+					{
+						p++;
+						long normal;
+						parseLong(p, end, &normal);		// normals aren't part of the vertex layout
+					}
+				}
+				polygon.push_back(corner);
+			}
+
+			// fan triangulation
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				chunk->corners.push_back(polygon[0]);
+				chunk->corners.push_back(polygon[i - 1]);
+				chunk->corners.push_back(polygon[i]);
+			}
+		}
+		else if (startsWith(c, end, "usemtl"))
+		{
+			chunk->materialSwitches.push_back({ chunk->corners.size(), restOfLine(c + 6, end) });
+		}
+		else if (startsWith(c, end, "mtllib"))
+		{
+			chunk->materialLibraries.push_back(restOfLine(c + 6, end));
+		}
+	}
+
+	if (!chunk->colors.empty())
+	{
+		chunk->colors.resize(chunk->positions.size(), glm::vec3(1.0f, 1.0f, 1.0f));
+	}
+}
+
+static void parseMaterialLibrary(const std::string& fileName, std::unordered_map<std::string, ObjMaterial>& materials)
+{
+	MappedFile file = readSceneFile(fileName);
+	const char* end = file.data() + file.size();
+
+	ObjMaterial* current = nullptr;
+	for (const char* c = file.data(); c < end; c = lineEnd(c, end) + 1)
+	{
+		c = skipSpaces(c, end);
+
+		if (startsWith(c, end, "newmtl"))
+		{
+			current = &materials[restOfLine(c + 6, end)];
+		}
+		else if (current && startsWith(c, end, "Kd"))
+		{
+			const char* p = c + 2;
+			float values[3] = { 1.0f, 1.0f, 1.0f };
+			parseFloats(p, end, values, 3);
+			current->diffuse = glm::vec3(values[0], values[1], values[2]);
+		}
+		else if (current && startsWith(c, end, "map_Kd"))
+		{
+			// options before the file name aren't supported, the name is the last token
+			std::string map = restOfLine(c + 6, end);
+			size_t space = map.find_last_of(" \t");
+			current->diffuseMap = space == std::string::npos ? map : map.substr(space + 1);
+		}
+	}
+}
+
+static SceneData loadObj(const std::string& fileName, JobSystem* jobSystem)
+{
+	MappedFile file = readSceneFile(fileName);
+	std::string directory = directoryOf(fileName);
+
+	// -- PARSE --
+	// split at line boundaries into chunks of at least 1MB, one per thread
+	const size_t minimumChunkSize = 1024 * 1024;
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), file.size() / minimumChunkSize));
+
+	const char* data = file.data();
+	const char* end = data + file.size();
+	std::vector<const char*> chunkStarts = { data };
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		const char* start = std::max(chunkStarts.back(), lineEnd(data + file.size() * i / chunkCount, end));
+		chunkStarts.push_back(std::min(start + 1, end));
+	}
+	chunkStarts.push_back(end);
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	parallelFor(jobSystem, chunkCount, [&](size_t i) {
+		parseObjChunk(chunkStarts[i], chunkStarts[i + 1], &chunks[i]);
+	});
+
+	// -- MERGE --
+	// concatenate attribute lists, remembering where each chunk's elements start
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec2> texCoords;
+	std::vector<size_t> positionBase(chunkCount);
+	std::vector<size_t> texCoordBase(chunkCount);
+	bool hasColors = false;
+
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		hasColors |= !chunks[i].colors.empty();
+	}
+
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		positionBase[i] = positions.size();
+		texCoordBase[i] = texCoords.size();
+		positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+		texCoords.insert(texCoords.end(), chunks[i].texCoords.begin(), chunks[i].texCoords.end());
+
+		if (hasColors)
+		{
+			if (chunks[i].colors.empty())
+			{
+				colors.resize(positions.size(), glm::vec3(1.0f, 1.0f, 1.0f));
+			}
+			else
+			{
+				colors.insert(colors.end(), chunks[i].colors.begin(), chunks[i].colors.end());
+			}
+		}
+	}
+
+	// group triangles by material, in order of first use
+	std::vector<std::string> materialNames = { "" };
+	std::vector<std::vector<ObjCorner>> materialCorners(1);
+	std::unordered_map<std::string, size_t> materialGroup = { { "", 0 } };
+	size_t currentGroup = 0;
+
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const ObjChunk& chunk = chunks[i];
+		size_t switchIndex = 0;
+
+		for (size_t corner = 0; corner < chunk.corners.size(); corner += 3)
+		{
+			while (switchIndex < chunk.materialSwitches.size() && chunk.materialSwitches[switchIndex].cornerOffset <= corner)
+			{
+				const std::string& name = chunk.materialSwitches[switchIndex++].material;
+				auto found = materialGroup.find(name);
+				if (found == materialGroup.end())
+				{
+					found = materialGroup.emplace(name, materialNames.size()).first;
+					materialNames.push_back(name);
+					materialCorners.emplace_back();
+				}
+				currentGroup = found->second;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				// resolve chunk relative indices now that the chunk bases are known
+				ObjCorner resolved = chunk.corners[corner + k];
+				if (resolved.relativeFlags & OBJ_CORNER_POSITION_RELATIVE)
+				{
+					resolved.position += static_cast<int>(positionBase[i]);
+				}
+				if (resolved.relativeFlags & OBJ_CORNER_TEXCOORD_RELATIVE)
+				{
+					resolved.texCoord += static_cast<int>(texCoordBase[i]);
+				}
+				resolved.relativeFlags = 0;
+				materialCorners[currentGroup].push_back(resolved);
+			}
+		}
+
+		// switches after the last face still apply to the next chunk
+		while (switchIndex < chunk.materialSwitches.size())
+		{
+			const std::string& name = chunk.materialSwitches[switchIndex++].material;
+			auto found = materialGroup.find(name);
+			if (found == materialGroup.end())
+			{
+				found = materialGroup.emplace(name, materialNames.size()).first;
+				materialNames.push_back(name);
+				materialCorners.emplace_back();
+			}
+			currentGroup = found->second;
+		}
+	}
+
+	// -- MATERIALS --
+	std::unordered_map<std::string, ObjMaterial> materials;
+	for (const ObjChunk& chunk : chunks)
+	{
+		for (const std::string& library : chunk.materialLibraries)
+		{
+			parseMaterialLibrary(directory + library, materials);
+		}
+	}
+
+	SceneData scene;
+	std::unordered_map<uint32_t, int> solidImages;
+	std::unordered_map<std::string, int> mapImages;
+	std::vector<std::string> mapFiles;
+	std::vector<int> groupImages(materialNames.size(), -1);
+	std::vector<glm::vec3> groupColors(materialNames.size(), glm::vec3(1.0f, 1.0f, 1.0f));
+
+	for (size_t g = 0; g < materialNames.size(); g++)
+	{
+		auto found = materials.find(materialNames[g]);
+		if (found == materials.end())
+		{
+			continue;
+		}
+
+		groupColors[g] = found->second.diffuse;
+		if (!found->second.diffuseMap.empty())
+		{
+			auto image = mapImages.find(found->second.diffuseMap);
+			if (image == mapImages.end())
+			{
+				image = mapImages.emplace(found->second.diffuseMap, static_cast<int>(mapFiles.size())).first;
+				mapFiles.push_back(found->second.diffuseMap);
+			}
+			groupImages[g] = image->second;
+		}
+	}
+
+	// textured groups use their map (the diffuse color is left in the vertex color), others a 1x1 image of their color
+	scene.images.resize(mapFiles.size());
+	for (size_t g = 0; g < materialNames.size(); g++)
+	{
+		if (groupImages[g] < 0 && !materialCorners[g].empty())
+		{
+			groupImages[g] = solidColorImage(scene, solidImages, glm::vec4(groupColors[g], 1.0f));
+		}
+	}
+
+	// -- MESHES --
+	// decode texture maps and build one indexed mesh per material group, all in parallel
+	std::vector<size_t> groups;
+	for (size_t g = 0; g < materialNames.size(); g++)
+	{
+		if (!materialCorners[g].empty())
+		{
+			groups.push_back(g);
+		}
+	}
+	scene.meshes.resize(groups.size());
+
+	parallelFor(jobSystem, mapFiles.size() + groups.size(), [&](size_t task) {
+		if (task < mapFiles.size())
+		{
+			decodeImageFile(directory + mapFiles[task], &scene.images[task]);
+			return;
+		}
+
+		size_t g = groups[task - mapFiles.size()];
+		SceneMesh& mesh = scene.meshes[task - mapFiles.size()];
+		mesh.imageIndex = groupImages[g];
+
+		// corners with the same position/texcoord pair share a vertex
+		std::unordered_map<uint64_t, uint32_t> vertexLookup;
+		mesh.indices.reserve(materialCorners[g].size());
+
+		for (const ObjCorner& corner : materialCorners[g])
+		{
+			if (corner.position < 0 || corner.position >= static_cast<int>(positions.size()))
+			{
+				throw std::runtime_error("OBJ face references a missing vertex! (" + fileName + ")");
+			}
+
+			bool hasTexCoord = corner.texCoord != INT_MAX && corner.texCoord >= 0 && corner.texCoord < static_cast<int>(texCoords.size());
+			uint64_t key = (uint64_t(uint32_t(corner.position)) << 32) | (hasTexCoord ? uint32_t(corner.texCoord) : 0xFFFFFFFFu);
+
+			auto found = vertexLookup.find(key);
+			if (found != vertexLookup.end())
+			{
+				mesh.indices.push_back(found->second);
+				continue;
+			}
+
+			Vertex vertex = {};
+			vertex.pos = positions[corner.position];
+			vertex.col = hasColors ? colors[corner.position] : groupColors[g];
+			if (hasTexCoord)
+			{
+				// OBJ texture coordinates start at the bottom left, images are loaded top row first
+				vertex.tex = glm::vec2(texCoords[corner.texCoord].x, 1.0f - texCoords[corner.texCoord].y);
+			}
+
+			uint32_t index = static_cast<uint32_t>(mesh.vertices.size());
+			mesh.vertices.push_back(vertex);
+			vertexLookup.emplace(key, index);
+			mesh.indices.push_back(index);
+		}
+	});
+
+	for (size_t i = 0; i < scene.meshes.size(); i++)
+	{
+		scene.instances.push_back({ static_cast<int>(i), glm::mat4(1.0f) });
+	}
+
+	return scene;
+}
+
+SceneData loadSceneFile(const std::string& fileName, JobSystem* jobSystem)
+{
+	std::string extension = extensionOf(fileName);
+
+	SceneData scene;
+	if (extension == "gltf" || extension == "glb")
+	{
+		scene = loadGltf(fileName, jobSystem);
+	}
+	else if (extension == "obj")
+	{
+		scene = loadObj(fileName, jobSystem);
+	}
+	else
+	{
+		throw std::runtime_error("Unsupported scene file type! (" + fileName + ")");
+	}
+
+	// anything without a usable image falls back to plain white
+	std::unordered_map<uint32_t, int> solidImages;
+	for (SceneMesh& mesh : scene.meshes)
+	{
+		if (mesh.imageIndex < 0 || mesh.imageIndex >= static_cast<int>(scene.images.size()))
+		{
+			mesh.imageIndex = solidColorImage(scene, solidImages, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+		}
+	}
+
+	return scene;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Utilities.h"
+
+// decoded RGBA8 image, ready for upload
+struct SceneImage {
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels;
+};
+
+// geometry already converted to the renderer's vertex layout
+struct SceneMesh {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	int imageIndex = -1;			// base color image in SceneData::images (untextured materials get a 1x1 image of their color)
+};
+
+// one placement of a mesh in the scene (a mesh used by several nodes has several instances)
+struct SceneInstance {
+	int meshIndex;
+	glm::mat4 transform;
+};
+
+struct SceneData {
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneImage> images;
+	std::vector<SceneInstance> instances;
+};
+
+// load a .gltf, .glb or .obj file (picked by extension), paths inside the file are relative to it
+// file reads, vertex conversion and image decoding are spread over worker threads (jobSystem's if given), no Vulkan calls are made
+// throws std::runtime_error if the file can't be read or parsed
+SceneData loadSceneFile(const std::string& fileName, JobSystem* jobSystem = nullptr);
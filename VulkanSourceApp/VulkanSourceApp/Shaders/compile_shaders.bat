@@ -1,3 +1,5 @@
 C:/VulkanSDK/1.3.236.0/Bin/glslangValidator.exe -V shader.vert
+C:/VulkanSDK/1.3.236.0/Bin/glslangValidator.exe -V -DOBJECT_DATA_STORAGE_BUFFER shader.vert -o vert_storage.spv
+C:/VulkanSDK/1.3.236.0/Bin/glslangValidator.exe -V -DOBJECT_DATA_DYNAMIC_UNIFORM_BUFFER shader.vert -o vert_dynamic.spv
 C:/VulkanSDK/1.3.236.0/Bin/glslangValidator.exe -V shader.frag
 pause
\ No newline at end of file
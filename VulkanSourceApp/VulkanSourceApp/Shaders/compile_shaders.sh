@@ -0,0 +1,45 @@
+#!/bin/sh
+# compile every shader variant to SPIR-V files (read at runtime) and to C headers in Generated/
+# (compiled into the executable by EmbeddedShaders.cpp, then no shader files are read at startup)
+# needs glslangValidator from the Vulkan SDK, in PATH or in $VULKAN_SDK/bin
+set -e
+cd "$(dirname "$0")"
+
+GLSLANG="glslangValidator"
+if [ -n "$VULKAN_SDK" ]; then
+	GLSLANG="$VULKAN_SDK/bin/glslangValidator"
+fi
+
+mkdir -p Generated
+
+# one line per variant: output name, source, defines
+# specialization constants (texture / vertex color) aren't variants here, they're picked when the pipeline is created
+VARIANTS="
+vert shader.vert
+vert_storage shader.vert -DOBJECT_DATA_STORAGE_BUFFER
+vert_dynamic shader.vert -DOBJECT_DATA_DYNAMIC_UNIFORM_BUFFER
+frag shader.frag
+"
+
+echo "$VARIANTS" | while read -r name source defines; do
+	[ -z "$name" ] && continue
+	"$GLSLANG" -V $defines "$source" -o "$name.spv"
+	"$GLSLANG" -V $defines "$source" --vn "${name}_spv" -o "Generated/$name.h"
+done
+
+# index of the headers above, keyed by the .spv path the pipeline asks for
+NAMES=$(echo "$VARIANTS" | awk 'NF { print $1 }')
+{
+	echo "// generated by compile_shaders.sh, do not edit"
+	echo "#pragma once"
+	echo ""
+	for name in $NAMES; do
+		echo "#include \"$name.h\""
+	done
+	echo ""
+	echo "static const EmbeddedShader embeddedShaders[] = {"
+	for name in $NAMES; do
+		echo "	{ \"Shaders/$name.spv\", ${name}_spv, sizeof(${name}_spv) },"
+	done
+	echo "};"
+} > Generated/embedded_shaders.h
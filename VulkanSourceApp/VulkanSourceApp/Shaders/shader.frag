@@ -1,5 +1,9 @@
 #version 450			// Use GLSL 4.5
 
+// paths switched per pipeline (PipelineState::shaderFeatures), the driver compiles out the ones that are off
+layout(constant_id = 0) const bool USE_TEXTURE = true;			// SHADER_FEATURE_TEXTURE_BIT
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = false;	// SHADER_FEATURE_VERTEX_COLOR_BIT
+
 layout(location = 0) in vec3 fragCol;
 layout(location = 1) in vec2 fragTex;
 
@@ -8,5 +12,15 @@ layout(set = 1, binding = 0) uniform sampler2D textureSampler;
 layout(location = 0) out vec4 outColor; //final output color (must also have location)
 
 void main() {
-	outColor = texture(textureSampler, fragTex);
+	outColor = vec4(1.0);
+
+	if (USE_TEXTURE)
+	{
+		outColor = texture(textureSampler, fragTex);
+	}
+
+	if (USE_VERTEX_COLOR)
+	{
+		outColor.rgb *= fragCol;
+	}
 }
\ No newline at end of file
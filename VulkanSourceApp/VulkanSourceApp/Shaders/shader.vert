@@ -1,5 +1,9 @@
 #version 450			// Use GLSL 4.5
 
+// variants (see compile_shaders.sh):
+// OBJECT_DATA_STORAGE_BUFFER : model matrix read from a per frame storage buffer (vert_storage.spv), otherwise pushed (vert.spv)
+// OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER : model matrix read from a uniform buffer moved by a dynamic offset per draw (vert_dynamic.spv)
+
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 col;
 layout(location = 2) in vec2 tex;
@@ -9,14 +13,21 @@ layout(set = 0, binding = 0) uniform UboViewProjection {
 	mat4 view;
 } uboViewProjection;
 
-// not in use, left for reference
+#ifdef OBJECT_DATA_STORAGE_BUFFER
+// per object data of this frame, indexed by the draw's firstInstance (= mesh id)
+layout(std430, set = 2, binding = 0) readonly buffer ObjectModels {
+	mat4 models[];
+} objectModels;
+#elif defined(OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER)
+// dynamic offset of the draw points it at the mesh's model in the frame allocator
 layout(set = 0, binding = 1) uniform UboModel {
 	mat4 model;
 } uboModel;
-
+#else
 layout(push_constant) uniform PushModel {
 	mat4 model;
 } pushModel;
+#endif
 
 layout(location = 0) out vec3 fragCol;
 layout(location = 1) out vec2 fragTex;
@@ -24,7 +35,15 @@ layout(location = 1) out vec2 fragTex;
 //resource loading
 
 void main() {
-	gl_Position = uboViewProjection.projection * uboViewProjection.view * pushModel.model * vec4(pos, 1.0);
+#ifdef OBJECT_DATA_STORAGE_BUFFER
+	mat4 model = objectModels.models[gl_InstanceIndex];
+#elif defined(OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER)
+	mat4 model = uboModel.model;
+#else
+	mat4 model = pushModel.model;
+#endif
+
+	gl_Position = uboViewProjection.projection * uboViewProjection.view * model * vec4(pos, 1.0);
 
 	fragCol = col;
 	fragTex = tex;
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// handles are 32 bits: the low bits pick a slot, the high bits are the slot's generation (bumped on every remove)
+const uint32_t SLOT_INDEX_BITS = 20;											// up to ~1M live elements per map
+const uint32_t SLOT_INDEX_MASK = (1u << SLOT_INDEX_BITS) - 1;
+const uint32_t SLOT_GENERATION_MASK = (1u << (32 - SLOT_INDEX_BITS)) - 1;		// wraps after 4095 reuses of a slot
+const uint32_t INVALID_SLOT_INDEX = UINT32_MAX;
+
+// elements packed in one dense array (iterated directly in hot loops), addressed from outside by generational handles
+// add() and remove() are O(1), remove() moves the last element into the hole, so dense indices change but handles don't
+// a removed element's handle is stale: get() returns nullptr and indexOf() INVALID_SLOT_INDEX for it
+// 0 is never a valid handle
+template<typename T>
+class SlotMap
+{
+public:
+	// handle of the new element, throws std::runtime_error if all slots are in use
+	uint32_t add(T value)
+	{
+		return emplace(std::move(value));
+	}
+
+	// like add(), but the element is constructed from args right in the dense array
+	template<typename... Args>
+	uint32_t emplace(Args&&... args)
+	{
+		uint32_t slotIndex;
+		if (!freeSlots.empty())
+		{
+			slotIndex = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			if (slots.size() > SLOT_INDEX_MASK)
+			{
+				throw std::runtime_error("Slot map is full");
+			}
+			slotIndex = static_cast<uint32_t>(slots.size());
+			slots.push_back({ INVALID_SLOT_INDEX, 1 });		// generation 0 is skipped, so handle 0 never exists
+		}
+
+		slots[slotIndex].denseIndex = static_cast<uint32_t>(dense.size());
+		dense.emplace_back(std::forward<Args>(args)...);
+		denseSlots.push_back(slotIndex);
+
+		return makeHandle(slotIndex);
+	}
+
+	// dense index the element was at (the previously last element is there now), INVALID_SLOT_INDEX for a stale handle
+	// owners of arrays parallel to the dense one mirror the move with the returned index
+	uint32_t remove(uint32_t handle)
+	{
+		uint32_t denseIndex = indexOf(handle);
+		if (denseIndex == INVALID_SLOT_INDEX)
+		{
+			return INVALID_SLOT_INDEX;
+		}
+
+		uint32_t lastIndex = static_cast<uint32_t>(dense.size()) - 1;
+		if (denseIndex != lastIndex)
+		{
+			dense[denseIndex] = std::move(dense[lastIndex]);
+			denseSlots[denseIndex] = denseSlots[lastIndex];
+			slots[denseSlots[denseIndex]].denseIndex = denseIndex;
+		}
+		dense.pop_back();
+		denseSlots.pop_back();
+
+		// outstanding handles of the slot go stale
+		Slot& slot = slots[handle & SLOT_INDEX_MASK];
+		slot.denseIndex = INVALID_SLOT_INDEX;
+		slot.generation = (slot.generation + 1) & SLOT_GENERATION_MASK;
+		if (slot.generation == 0)
+		{
+			slot.generation = 1;
+		}
+		freeSlots.push_back(handle & SLOT_INDEX_MASK);
+
+		return denseIndex;
+	}
+
+	// position in the dense array, INVALID_SLOT_INDEX if the handle is stale (or was never handed out)
+	uint32_t indexOf(uint32_t handle) const
+	{
+		uint32_t slotIndex = handle & SLOT_INDEX_MASK;
+		if (slotIndex >= slots.size() || slots[slotIndex].generation != (handle >> SLOT_INDEX_BITS))
+		{
+			return INVALID_SLOT_INDEX;
+		}
+		return slots[slotIndex].denseIndex;
+	}
+
+	T* get(uint32_t handle)
+	{
+		uint32_t denseIndex = indexOf(handle);
+		return denseIndex == INVALID_SLOT_INDEX ? nullptr : &dense[denseIndex];
+	}
+
+	bool contains(uint32_t handle) const
+	{
+		return indexOf(handle) != INVALID_SLOT_INDEX;
+	}
+
+	// handle of the element at a dense index
+	uint32_t handleAt(uint32_t denseIndex) const
+	{
+		return makeHandle(denseSlots[denseIndex]);
+	}
+
+	// dense access, in no particular order
+	T& atIndex(uint32_t denseIndex) { return dense[denseIndex]; }
+	T* data() { return dense.data(); }
+	uint32_t size() const { return static_cast<uint32_t>(dense.size()); }
+	bool empty() const { return dense.empty(); }
+
+	void reserve(size_t count)
+	{
+		dense.reserve(count);
+		denseSlots.reserve(count);
+	}
+
+	// remove everything, every handle goes stale
+	void clear()
+	{
+		while (!dense.empty())
+		{
+			remove(handleAt(size() - 1));
+		}
+	}
+
+private:
+	struct Slot {
+		uint32_t denseIndex;		// INVALID_SLOT_INDEX while the slot is free
+		uint32_t generation;
+	};
+
+	std::vector<T> dense;
+	std::vector<uint32_t> denseSlots;		// slot of each dense element (for handleAt() and moving on remove)
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+
+	uint32_t makeHandle(uint32_t slotIndex) const
+	{
+		return (slots[slotIndex].generation << SLOT_INDEX_BITS) | slotIndex;
+	}
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// bounded lock-free queue for exactly one producer thread and one consumer thread
+// a ring buffer with a power of two capacity, the producer only writes tail and the consumer only writes head,
+// each of them on its own cache line so the two threads don't keep invalidating each other's
+template <typename T>
+class SpscQueue
+{
+public:
+	// capacity is rounded up to a power of two
+	explicit SpscQueue(size_t capacity)
+	{
+		size_t roundedCapacity = 1;
+		while (roundedCapacity < capacity)
+		{
+			roundedCapacity <<= 1;
+		}
+
+		items.resize(roundedCapacity);
+		mask = roundedCapacity - 1;
+	}
+
+	// producer only, false if the queue is full
+	bool push(const T& item)
+	{
+		size_t currentTail = tail.load(std::memory_order_relaxed);
+		if (currentTail - head.load(std::memory_order_acquire) > mask)
+		{
+			return false;
+		}
+
+		items[currentTail & mask] = item;
+		tail.store(currentTail + 1, std::memory_order_release);		// publishes the item to the consumer
+		return true;
+	}
+
+	// consumer only, false if the queue is empty
+	bool pop(T& item)
+	{
+		size_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = items[currentHead & mask];
+		head.store(currentHead + 1, std::memory_order_release);		// hands the slot back to the producer
+		return true;
+	}
+
+	// only a snapshot when called from the other thread
+	bool empty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<T> items;
+	size_t mask;
+
+	alignas(64) std::atomic<size_t> head{ 0 };		// next item to pop (written by the consumer)
+	alignas(64) std::atomic<size_t> tail{ 0 };		// next slot to push to (written by the producer)
+};
@@ -0,0 +1,187 @@
+#include "UploadBatch.h"
+
+#include <algorithm>
+#include <cstring>
+
+UploadBatch::UploadBatch(DeviceMemoryInfo& newMemoryInfo, VkDevice newDevice, QueueTimeline& newTransferTimeline, VkCommandPool newTransferCommandPool)
+{
+	memoryInfo = &newMemoryInfo;
+	device = newDevice;
+	transferTimeline = &newTransferTimeline;
+	transferCommandPool = newTransferCommandPool;
+}
+
+void UploadBatch::uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	stage(data, size, &stagingBuffer, &stagingOffset);
+
+	VkBufferCopy bufferCopyRegion = {};
+	bufferCopyRegion.srcOffset = stagingOffset;
+	bufferCopyRegion.dstOffset = dstOffset;
+	bufferCopyRegion.size = size;
+
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, dstBuffer, 1, &bufferCopyRegion);
+}
+
+void UploadBatch::uploadImage(const void* pixels, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height,
+	uint32_t mipLevel, uint32_t baseArrayLayer, uint32_t layerCount)
+{
+	ImageCopy imageCopy = {};
+	imageCopy.image = image;
+	imageCopy.width = width;
+	imageCopy.height = height;
+	imageCopy.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageCopy.subresource.mipLevel = mipLevel;
+	imageCopy.subresource.baseArrayLayer = baseArrayLayer;
+	imageCopy.subresource.layerCount = layerCount;
+	stage(pixels, size, &imageCopy.stagingBuffer, &imageCopy.stagingOffset);
+
+	// recorded on submit, so all images share their barriers
+	imageCopies.push_back(imageCopy);
+}
+
+void UploadBatch::submit()
+{
+	if (commandBuffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	recordImageCopies();
+	vkEndCommandBuffer(commandBuffer);
+
+	// wait only for this submission's value, so other work on the queue doesn't have to drain like with vkQueueWaitIdle
+	TimelineSubmit timelineSubmit = {};
+	timelineSubmit.commandBufferCount = 1;
+	timelineSubmit.pCommandBuffers = &commandBuffer;
+
+	uint64_t uploadValue = transferTimeline->submit(timelineSubmit);
+	transferTimeline->wait(uploadValue);
+
+	vkFreeCommandBuffers(device, transferCommandPool, 1, &commandBuffer);
+	commandBuffer = VK_NULL_HANDLE;
+
+	releaseStaging();
+}
+
+UploadBatch::~UploadBatch()
+{
+	// a batch that was never submitted (e.g. loading threw) just drops its recorded commands
+	if (commandBuffer != VK_NULL_HANDLE)
+	{
+		vkEndCommandBuffer(commandBuffer);
+		vkFreeCommandBuffers(device, transferCommandPool, 1, &commandBuffer);
+	}
+	imageCopies.clear();
+	releaseStaging();
+}
+
+void UploadBatch::stage(const void* data, VkDeviceSize size, VkBuffer* stagingBuffer, VkDeviceSize* stagingOffset)
+{
+	// start recording on first use
+	if (commandBuffer == VK_NULL_HANDLE)
+	{
+		commandBuffer = beginCommandBuffer(device, transferCommandPool);
+	}
+
+	// 16 byte alignment covers buffer copies and texel alignment of every format we upload
+	const VkDeviceSize alignment = 16;
+
+	StagingBlock* block = stagingBlocks.empty() ? nullptr : &stagingBlocks.back();
+	VkDeviceSize offset = block ? (block->used + alignment - 1) & ~(alignment - 1) : 0;
+
+	// open a new block if the current one is full, oversized uploads get a block of their own
+	if (!block || offset + size > block->size)
+	{
+		StagingBlock newBlock = {};
+		VkDeviceSize blockSize = block ? std::min(block->size * 2, UPLOAD_STAGING_MAX_BLOCK_SIZE) : UPLOAD_STAGING_MIN_BLOCK_SIZE;
+		newBlock.size = std::max(size, blockSize);
+
+		createBuffer(*memoryInfo, device, newBlock.size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&newBlock.buffer, &newBlock.memory);
+
+		// stays mapped until the batch is submitted
+		vkMapMemory(device, newBlock.memory, 0, newBlock.size, 0, &newBlock.mapped);
+
+		stagingBlocks.push_back(newBlock);
+		block = &stagingBlocks.back();
+		offset = 0;
+	}
+
+	memcpy(static_cast<char*>(block->mapped) + offset, data, static_cast<size_t>(size));
+	block->used = offset + size;
+
+	*stagingBuffer = block->buffer;
+	*stagingOffset = offset;
+}
+
+void UploadBatch::recordImageCopies()
+{
+	if (imageCopies.empty())
+	{
+		return;
+	}
+
+	// transition every image to be DST for copy operation, in one barrier
+	std::vector<VkImageMemoryBarrier> barriers(imageCopies.size());
+	VkPipelineStageFlags srcStage = 0;
+	VkPipelineStageFlags dstStage = 0;
+	for (size_t i = 0; i < imageCopies.size(); i++)
+	{
+		const VkImageSubresourceLayers& subresource = imageCopies[i].subresource;
+		barriers[i] = createImageLayoutBarrier(imageCopies[i].image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount, &srcStage, &dstStage);
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0,
+		0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	// copy image data
+	for (const ImageCopy& imageCopy : imageCopies)
+	{
+		VkBufferImageCopy imageRegion = {};
+		imageRegion.bufferOffset = imageCopy.stagingOffset;
+		imageRegion.bufferRowLength = 0;
+		imageRegion.bufferImageHeight = 0;
+		imageRegion.imageSubresource = imageCopy.subresource;
+		imageRegion.imageOffset = { 0, 0, 0 };
+		imageRegion.imageExtent = { imageCopy.width, imageCopy.height, 1 };
+
+		vkCmdCopyBufferToImage(commandBuffer, imageCopy.stagingBuffer, imageCopy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
+	}
+
+	// transition every image to be shader readable for shader usage, in one barrier
+	srcStage = 0;
+	dstStage = 0;
+	for (size_t i = 0; i < imageCopies.size(); i++)
+	{
+		const VkImageSubresourceLayers& subresource = imageCopies[i].subresource;
+		barriers[i] = createImageLayoutBarrier(imageCopies[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount, &srcStage, &dstStage);
+	}
+
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0,
+		0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	imageCopies.clear();
+}
+
+void UploadBatch::releaseStaging()
+{
+	for (StagingBlock& block : stagingBlocks)
+	{
+		vkUnmapMemory(device, block.memory);
+		vkDestroyBuffer(device, block.buffer, nullptr);
+		vkFreeMemory(device, block.memory, nullptr);
+	}
+	stagingBlocks.clear();
+}
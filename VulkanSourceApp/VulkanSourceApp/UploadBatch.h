@@ -0,0 +1,74 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "QueueTimeline.h"
+#include "Utilities.h"
+
+// staging memory is sub-allocated from blocks, the first one sized to its upload (at least the minimum), each further one
+// twice the last up to the maximum, so a batch of one small mesh doesn't map 64MB (an upload larger than that gets a block of its own)
+const VkDeviceSize UPLOAD_STAGING_MIN_BLOCK_SIZE = 64 * 1024;
+const VkDeviceSize UPLOAD_STAGING_MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+// collects buffer and image uploads into one command buffer, submitted once through the queue's timeline
+// and waited for by value (instead of one submit + vkQueueWaitIdle per copy)
+// image copies are recorded on submit, between one barrier taking every image to TRANSFER_DST and one making them all shader readable
+class UploadBatch
+{
+public:
+	UploadBatch(DeviceMemoryInfo& newMemoryInfo, VkDevice newDevice, QueueTimeline& newTransferTimeline, VkCommandPool newTransferCommandPool);
+
+	// copy data into staging memory now and record the copy into dstBuffer
+	void uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+
+	// copy RGBA8 pixels into staging memory now, the image goes UNDEFINED -> TRANSFER_DST, is copied to and goes
+	// TRANSFER_DST -> SHADER_READ_ONLY together with every other image of the batch
+	// pixels fill mip level mipLevel of layers [baseArrayLayer, baseArrayLayer + layerCount) one layer after the other,
+	// width / height are that mip level's size, the barriers only cover the subresources written
+	void uploadImage(const void* pixels, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height,
+		uint32_t mipLevel = 0, uint32_t baseArrayLayer = 0, uint32_t layerCount = 1);
+
+	// submit everything recorded so far, wait for it and release the staging memory (no-op if nothing was recorded)
+	void submit();
+
+	~UploadBatch();
+
+private:
+	struct StagingBlock {
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		void* mapped;
+		VkDeviceSize size;
+		VkDeviceSize used;
+	};
+
+	DeviceMemoryInfo* memoryInfo;
+	VkDevice device;
+	QueueTimeline* transferTimeline;
+	VkCommandPool transferCommandPool;
+
+	// image copy waiting for the batch's shared barriers
+	struct ImageCopy {
+		VkImage image;
+		VkBuffer stagingBuffer;
+		VkDeviceSize stagingOffset;
+		uint32_t width;
+		uint32_t height;
+		VkImageSubresourceLayers subresource;
+	};
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	std::vector<StagingBlock> stagingBlocks;
+	std::vector<ImageCopy> imageCopies;
+
+	// copy data into staging memory, returns buffer and offset it was placed at
+	void stage(const void* data, VkDeviceSize size, VkBuffer* stagingBuffer, VkDeviceSize* stagingOffset);
+
+	// barrier for all images, their copies, barrier for all images
+	void recordImageCopies();
+
+	void releaseStaging();
+};
@@ -1,13 +1,43 @@
 #pragma once
 
-#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
-const int MAX_FRAME_DRAWS = 2;
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;		// frames the CPU may prepare ahead of the GPU, changed with VulkanRenderer::setFramesInFlight
 const int MAX_OBJECTS = 100;
+const size_t RENDER_COMMAND_QUEUE_SIZE = 4096;	// scene changes that can be queued for the render thread before the caller has to wait
+const size_t LOD_SELECTION_BATCH_SIZE = 256;		// meshes per job when picking levels of detail
+const double IDLE_EVENT_TIMEOUT = 0.25;		// longest VulkanRenderer::pollEvents() blocks while there is nothing to draw (seconds)
+
+// where the vertex shader gets per object data (model matrix etc.) from
+enum ObjectDataMode {
+	OBJECT_DATA_PUSH_CONSTANTS,		// model matrix pushed before every draw (Shaders/vert.spv)
+	OBJECT_DATA_STORAGE_BUFFER,		// per frame storage buffers indexed by gl_InstanceIndex (Shaders/vert_storage.spv)
+	OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER,	// copied to the frame allocator, one dynamic uniform buffer offset per draw (Shaders/vert_dynamic.spv)
+};
+
+// what the swapchain is set up for: present mode, swapchain image count and frames in flight
+enum PresentPolicy {
+	PRESENT_POLICY_LOW_LATENCY,		// MAILBOX (else IMMEDIATE, else FIFO), 1 frame in flight
+	PRESENT_POLICY_THROUGHPUT,		// MAILBOX (else FIFO), one spare swapchain image, DEFAULT_FRAMES_IN_FLIGHT
+	PRESENT_POLICY_POWER_SAVING,		// FIFO (vsync), fewest swapchain images, 1 frame in flight
+};
+
+// where createBuffer() may place a buffer beyond the memory properties it requires
+enum BufferMemoryFlagBits {
+	BUFFER_MEMORY_DIRECT_WRITE_BIT = 0x00000001,	// device local memory the CPU writes into directly (UMA, resizable BAR) if there is budget for it
+};
+typedef uint32_t BufferMemoryFlags;
+
+// generational handles into the renderer's slot maps (SlotMap.h), a removed mesh's or texture's handle stays invalid
+typedef uint32_t MeshHandle;
+typedef uint32_t TextureHandle;
 
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
@@ -42,42 +72,87 @@ struct SwapChainDetails {
 struct SwapchainImage {
 	VkImage image;
 	VkImageView imageView;
+	VkSemaphore renderFinished;		// signalled by the submission drawing to it, waited on by its present
 };
 
-static std::vector<char> readFile(const std::string& filename)
+// memory types and heaps of the physical device, queried once when the device is picked instead of for every buffer
+// what's left of a heap changes with every allocation, so that is looked up when a heap is picked (getHeapAvailable())
+struct DeviceMemoryInfo {
+	VkPhysicalDevice physicalDevice;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	bool budgetSupported;									// VK_EXT_memory_budget
+	VkDeviceSize heapAllocated[VK_MAX_MEMORY_HEAPS];		// bytes createBuffer() placed in each heap (frees aren't counted back)
+	VkDeviceSize largestLocalHeap;							// size of the largest device local heap
+};
+
+static DeviceMemoryInfo getDeviceMemoryInfo(VkPhysicalDevice physicalDevice)
 {
-	// open stream from given file
-	// std::ios::binary tells stream to read file as binra
-	// std::ios::ate tells stream to start reading from end of file
-	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	DeviceMemoryInfo memoryInfo = {};
+	memoryInfo.physicalDevice = physicalDevice;
+
+	// budget (what's left of a heap, other processes included) is reported with VK_EXT_memory_budget
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
 
-	// check if file stream succesfully opened
-	if (!file.is_open())
+	for (const VkExtensionProperties& extension : extensions)
 	{
-		throw std::runtime_error("faild to open a file");
+		if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+		{
+			memoryInfo.budgetSupported = true;
+		}
 	}
 
-	// get current read position and use to resize the file buffer
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> fileBuffer(fileSize);
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryInfo.memoryProperties);
+	for (uint32_t i = 0; i < memoryInfo.memoryProperties.memoryHeapCount; i++)
+	{
+		const VkMemoryHeap& heap = memoryInfo.memoryProperties.memoryHeaps[i];
+		if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			memoryInfo.largestLocalHeap = std::max(memoryInfo.largestLocalHeap, heap.size);
+		}
+	}
 
-	// move read position (seek to) the start of the file
-	file.seekg(0);
+	return memoryInfo;
+}
 
-	//read the file data into the buffer(stream "fileSize" in total)
-	file.read(fileBuffer.data(), fileSize);
+// bytes still free in every heap right now: budget minus usage (of this process, which includes everything allocated so far)
+// with VK_EXT_memory_budget, otherwise the whole heap minus what createBuffer() placed in it
+static void getHeapAvailable(const DeviceMemoryInfo& memoryInfo, VkDeviceSize* heapAvailable)
+{
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = memoryInfo.memoryProperties;
 
-	//close stream
-	file.close();
+	if (!memoryInfo.budgetSupported)
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			VkDeviceSize size = memoryProperties.memoryHeaps[i].size;
+			heapAvailable[i] = size > memoryInfo.heapAllocated[i] ? size - memoryInfo.heapAllocated[i] : 0;
+		}
+		return;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+	memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties2.pNext = &budgetProperties;
+	vkGetPhysicalDeviceMemoryProperties2(memoryInfo.physicalDevice, &memoryProperties2);
 
-	return fileBuffer;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		VkDeviceSize budget = budgetProperties.heapBudget[i];
+		VkDeviceSize usage = budgetProperties.heapUsage[i];
+		heapAvailable[i] = budget > usage ? budget - usage : 0;
+	}
 }
 
-static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
+static uint32_t findMemoryTypeIndex(const DeviceMemoryInfo& memoryInfo, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
 {
-	// get properties of physical device memory
-	VkPhysicalDeviceMemoryProperties memoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	// properties of physical device memory
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = memoryInfo.memoryProperties;
 
 	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
 	{
@@ -91,7 +166,43 @@ static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t al
 	}
 }
 
-static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, VkDeviceMemory* bufferMemory)
+// device local, host visible and coherent memory type with properties, only where it is the GPU's real memory and not a window into it:
+// its heap has to be the largest device local heap (true on integrated GPUs, software drivers and with resizable BAR, not for the
+// 256MB BAR of other discrete GPUs) and have budget left for size, returns UINT32_MAX if there's no such type
+static uint32_t findDirectWriteMemoryTypeIndex(const DeviceMemoryInfo& memoryInfo, uint32_t allowedTypes, VkMemoryPropertyFlags properties, VkDeviceSize size)
+{
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = memoryInfo.memoryProperties;
+
+	// looked up for every pick, a budget from earlier doesn't know about what was allocated since
+	VkDeviceSize heapAvailable[VK_MAX_MEMORY_HEAPS];
+	getHeapAvailable(memoryInfo, heapAvailable);
+
+	properties |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if (!(allowedTypes & (1 << i)) || (memoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+		{
+			continue;
+		}
+
+		uint32_t heapIndex = memoryProperties.memoryTypes[i].heapIndex;
+		if (memoryProperties.memoryHeaps[heapIndex].size < memoryInfo.largestLocalHeap)
+		{
+			continue;
+		}
+
+		if (size <= heapAvailable[heapIndex])
+		{
+			return i;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+// returns the property flags of the memory the buffer ended up in: with BUFFER_MEMORY_DIRECT_WRITE_BIT a buffer may get host visible
+// memory even if bufferProperties didn't ask for it (fill it by mapping then, through a staging copy otherwise)
+static VkMemoryPropertyFlags createBuffer(DeviceMemoryInfo& memoryInfo, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, VkDeviceMemory* bufferMemory, BufferMemoryFlags memoryFlags = 0)
 {
 	// CREATE VERTEX BUFFER
 	// information to create a buffer (doesn't include assigning memory)
@@ -115,7 +226,15 @@ static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
 	VkMemoryAllocateInfo memoryAllocInfo = {};
 	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	memoryAllocInfo.allocationSize = memoryRequirements.size;
-	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits,	 bufferProperties);																																									
+	memoryAllocInfo.memoryTypeIndex = UINT32_MAX;
+	if (memoryFlags & BUFFER_MEMORY_DIRECT_WRITE_BIT)
+	{
+		memoryAllocInfo.memoryTypeIndex = findDirectWriteMemoryTypeIndex(memoryInfo, memoryRequirements.memoryTypeBits, bufferProperties, memoryRequirements.size);
+	}
+	if (memoryAllocInfo.memoryTypeIndex == UINT32_MAX)
+	{
+		memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(memoryInfo, memoryRequirements.memoryTypeBits, bufferProperties);
+	}																																									
 	// memoryTypeBits index of memory type on physical device that has required bit flags
 	// bufferPorperties	:
 	// VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT		:	CPU can interact with memory
@@ -131,6 +250,20 @@ static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
 
 	// allocate memory to given vertex buffer
 	vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
+
+	// what's left of the heap without VK_EXT_memory_budget
+	memoryInfo.heapAllocated[memoryInfo.memoryProperties.memoryTypes[memoryAllocInfo.memoryTypeIndex].heapIndex] += memoryRequirements.size;
+
+	return memoryInfo.memoryProperties.memoryTypes[memoryAllocInfo.memoryTypeIndex].propertyFlags;
+}
+
+// copy data straight into host visible coherent memory, the GPU sees it from the next queue submission on
+static void writeMemory(VkDevice device, VkDeviceMemory memory, const void* data, VkDeviceSize size)
+{
+	void* mapped;
+	vkMapMemory(device, memory, 0, size, 0, &mapped);
+	memcpy(mapped, data, static_cast<size_t>(size));
+	vkUnmapMemory(device, memory);
 }
 
 static VkCommandBuffer beginCommandBuffer(VkDevice device, VkCommandPool commandPool)
@@ -159,70 +292,11 @@ static VkCommandBuffer beginCommandBuffer(VkDevice device, VkCommandPool command
 	return commandBuffer;
 }
 
-static void endAndSubmitCommandBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer)
+// barrier moving mips [baseMipLevel, baseMipLevel + levelCount) of layers [baseArrayLayer, baseArrayLayer + layerCount) from oldLayout to newLayout
+// the stages it needs are ORed into srcStage / dstStage, so barriers of many images can go into one vkCmdPipelineBarrier
+static VkImageMemoryBarrier createImageLayoutBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+	uint32_t baseMipLevel, uint32_t levelCount, uint32_t baseArrayLayer, uint32_t layerCount, VkPipelineStageFlags* srcStage, VkPipelineStageFlags* dstStage)
 {
-	// end commands
-	vkEndCommandBuffer(commandBuffer);
-
-	// queue submission information
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	// submit transfer command to transfer queue and wait until it finishes
-	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue);
-
-	// free temporary command buffer back to pool
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
-static void copyBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool,
-	VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize)
-{
-	// create buffer
-	VkCommandBuffer transferCommandBuffer = beginCommandBuffer(device, transferCommandPool);
-
-	// region of data to copy form and to
-	VkBufferCopy bufferCopyRegion = {};
-	bufferCopyRegion.srcOffset = 0;
-	bufferCopyRegion.dstOffset = 0;
-	bufferCopyRegion.size = bufferSize;
-
-	// command to copy src buffer to dst buffer
-	vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
-
-	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
-}
-
-static void copyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height)
-{
-	// create buffer
-	VkCommandBuffer transferCommandBuffer = beginCommandBuffer(device, transferCommandPool);
-
-	VkBufferImageCopy imageRegion = {};
-	imageRegion.bufferOffset = 0;																					// offset into data
-	imageRegion.bufferRowLength = 0;																			// row length of data to calculate data spacing
-	imageRegion.bufferImageHeight = 0;																			// image height to calculate data spacing
-	imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;		// which aspect of image to copy
-	imageRegion.imageSubresource.mipLevel = 0;															// Mipmap level to copy
-	imageRegion.imageSubresource.baseArrayLayer = 0;													// starting array layer (if array)
-	imageRegion.imageSubresource.layerCount = 1;														// number of layers to copy starting at baseArrayLayer
-	imageRegion.imageOffset = { 0, 0, 0 };																		// offset into image (as opposet to raw data in bufferOffset)
-	imageRegion.imageExtent = { width, height, 1 };															// size of region to copy as (x, y, z) values
-
-	// copy buffer to given image
-	vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
-
-	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
-}
-
-static void transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-	// create buffer
-	VkCommandBuffer commandBuffer = beginCommandBuffer(device,commandPool);
-
 	VkImageMemoryBarrier memoryBarrier = {};
 	memoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	memoryBarrier.oldLayout = oldLayout;																		// layout to transition from
@@ -231,40 +305,32 @@ static void transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool
 	memoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;						// queue family to transition to
 	memoryBarrier.image = image;																					// image being accessed and modified as part of barrier
 	memoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;	// aspect of image being altered
-	memoryBarrier.subresourceRange.baseMipLevel = 0;													// first mip level to start alterations on
-	memoryBarrier.subresourceRange.levelCount = 1;														// number of mip levels to alter starting from baseMipLevel (1 is the inital image)
-	memoryBarrier.subresourceRange.baseArrayLayer = 0;												// first layer to start alterations on
-	memoryBarrier.subresourceRange.layerCount = 1;														// number of layers to alter starting from baseArrayLayer
-
-	VkPipelineStageFlags srcStage;
-	VkPipelineStageFlags dstStage;
+	memoryBarrier.subresourceRange.baseMipLevel = baseMipLevel;								// first mip level to start alterations on
+	memoryBarrier.subresourceRange.levelCount = levelCount;										// number of mip levels to alter starting from baseMipLevel (VK_REMAINING_MIP_LEVELS for all)
+	memoryBarrier.subresourceRange.baseArrayLayer = baseArrayLayer;							// first layer to start alterations on
+	memoryBarrier.subresourceRange.layerCount = layerCount;										// number of layers to alter starting from baseArrayLayer (VK_REMAINING_ARRAY_LAYERS for all)
 
 	// if transitioning from new image to image ready to receive data...
 	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
 	{
 		memoryBarrier.srcAccessMask = 0;																// memory access stage transition must after...
 		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;			// memory access stage transition must before...
-		
-		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		*srcStage |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		*dstStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
 	} // if transitioning from transfer destination to shader readable...
 	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 	{
 		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;						// textures are usually read from in the fragment shader, so make sure it is ready before shader reads it
+		*srcStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		*dstStage |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;						// textures are usually read from in the fragment shader, so make sure it is ready before shader reads it
+	}
+	else
+	{
+		throw std::runtime_error("Unsupported image layout transition");
 	}
-	
-	vkCmdPipelineBarrier(
-		commandBuffer,
-		srcStage, dstStage,								// Pipeline stages (match to src and dst AccessMasks)
-		0,									// dependency flags
-		0, nullptr,						// memory barrier count + data
-		0, nullptr,						// buffer memory barrier count + data
-		1, &memoryBarrier		// image memory barrier count + data
-	);
-
-	endAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
+
+	return memoryBarrier;
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+// sole owner of a Vulkan handle: move-only, so a copy can never destroy it a second time (or leave it to nobody)
+// as small as the handle itself, the device it was created on is kept once by whatever owns a group of them
+// (MeshBuffers, a texture), which destroys what's still owned in its own destructor through reset(device)
+// the destroy function is part of the type (not an overload on T, non-dispatchable handles are all uint64_t on 32 bit)
+// anything the GPU may have used goes through release() to whatever destroys it once the GPU is done
+// (the DeletionQueue, with the handle's last use value)
+template<typename T, void (VKAPI_PTR* Destroy)(VkDevice, T, const VkAllocationCallbacks*)>
+class UniqueHandle
+{
+public:
+	UniqueHandle() {}
+	explicit UniqueHandle(T newHandle) : handle(newHandle) {}
+
+	UniqueHandle(const UniqueHandle&) = delete;
+	UniqueHandle& operator=(const UniqueHandle&) = delete;
+
+	UniqueHandle(UniqueHandle&& other) noexcept : handle(other.release()) {}
+	// swaps: a handle held so far isn't lost, it goes to other and is destroyed by other's owner
+	UniqueHandle& operator=(UniqueHandle&& other) noexcept
+	{
+		T held = handle;
+		handle = other.handle;
+		other.handle = held;
+		return *this;
+	}
+
+	T get() const { return handle; }
+	explicit operator bool() const { return handle != VK_NULL_HANDLE; }
+
+	// out parameter for vkCreate*() / vkAllocate*() style functions, only on an empty handle
+	T* put() { return &handle; }
+
+	// give up ownership, the caller destroys it
+	T release()
+	{
+		T released = handle;
+		handle = VK_NULL_HANDLE;
+		return released;
+	}
+
+	// destroy the handle now
+	void reset(VkDevice device)
+	{
+		if (handle != VK_NULL_HANDLE)
+		{
+			Destroy(device, handle, nullptr);
+			handle = VK_NULL_HANDLE;
+		}
+	}
+
+private:
+	T handle = VK_NULL_HANDLE;
+};
+
+typedef UniqueHandle<VkBuffer, vkDestroyBuffer> UniqueBuffer;
+typedef UniqueHandle<VkDeviceMemory, vkFreeMemory> UniqueDeviceMemory;
+typedef UniqueHandle<VkImage, vkDestroyImage> UniqueImage;
+typedef UniqueHandle<VkImageView, vkDestroyImageView> UniqueImageView;
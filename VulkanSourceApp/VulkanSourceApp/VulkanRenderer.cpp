@@ -1,5 +1,13 @@
 #include "VulkanRenderer.h"
 
+// same removal as SlotMap::remove() on an array kept in the slot map's dense order
+template<typename T>
+static void swapRemove(std::vector<T>& array, uint32_t index)
+{
+	array[index] = array.back();
+	array.pop_back();
+}
+
 VulkanRenderer::VulkanRenderer()
 {
 }
@@ -8,12 +16,19 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 {
 	window = newWindow;
 
+	// the OS asks for a redraw when the window's contents were lost (e.g. restored from minimized)
+	glfwSetWindowUserPointer(window, this);
+	glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+
 	try {
+		jobSystem.init();
 		createInstance();
 		createSurface();
 		getPhysicalDevice();
 		createLogicalDevice();
+		deletionQueue.init(mainDevice.logicalDevice);
 		createSwapChain();
+		createPipelineCache();
 		createRenderPass();
 		createDescriptorSetLayout();
 		createPushConstantRange();
@@ -21,13 +36,10 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 		createDepthBufferImage();
 		createFramebuffers();
 		createCommandPool();
-		createCommandBuffers();
 		createTextureSampler();
-		//allocateDynamicBufferTransferSpace(); // only for dynamic uniform buffer
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createSynchronization();
+		createTextureDescriptorAllocator();
+		createFrameResources();
+		initialized = true;
 
 		// mvp matrices
 		uboViewProjection.projection = glm::perspective(glm::radians(45.0f), (float)swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 100.0f);
@@ -35,6 +47,7 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 		uboViewProjection.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
 		uboViewProjection.projection[1][1] *= -1; // openGL and glm use positive value as up in Y coordinate, but vulkan use negative as up , so flip the projection matrix
+		viewProjectionGeneration++;
 
 		// create a mesh
 		// vertex data
@@ -60,8 +73,17 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 			2, 3, 0
 		};
 
-		meshList.push_back(Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, &meshVertices[0], &meshIndices, createTexture("tex1.jpg")));
-		meshList.push_back(Mesh(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, &meshVertices[1], &meshIndices, createTexture("tex1.jpg")));
+		// both textures in one upload
+		std::vector<TextureHandle> textureIds = createTextures({ "tex1.jpg", "tex1.jpg" });
+
+		// and both meshes in another one
+		UploadBatch uploadBatch(deviceMemoryInfo, mainDevice.logicalDevice, graphicsTimeline, graphicsCommandPool);
+		for (size_t i = 0; i < meshVertices.size(); i++)
+		{
+			SharedMeshBuffers& shared = addMeshBuffers(createMeshBuffers(deviceMemoryInfo, mainDevice.logicalDevice, uploadBatch, &meshVertices[i], &meshIndices));
+			addMesh(shared, textureIds[i], glm::mat4(1.0f));
+		}
+		uploadBatch.submit();
 	}
 	catch (const std::runtime_error& e) {
 		printf("ERROR: %s\n", e.what());
@@ -72,132 +94,747 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 	return 0;
 }
 
-void VulkanRenderer::updateModel(int modelId, glm::mat4 newModel)
+void VulkanRenderer::updateModel(MeshHandle mesh, glm::mat4 newModel)
+{
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_UPDATE_MODEL;
+	command.mesh = mesh;
+	command.matrix = newModel;
+	submitRenderCommand(command);
+}
+
+void VulkanRenderer::updateModels(const MeshHandle* meshes, const glm::mat4* models, size_t count)
+{
+	// applied at once without the render thread, nothing to batch
+	if (!renderThread.joinable())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			updateModel(meshes[i], models[i]);
+		}
+		return;
+	}
+
+	// one command for the whole batch instead of one per matrix, the render thread frees the copy once it's applied
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_UPDATE_MODELS;
+	command.modelUpdates = new std::vector<ModelUpdate>(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		(*command.modelUpdates)[i].mesh = meshes[i];
+		(*command.modelUpdates)[i].model = models[i];
+	}
+
+	if (!submitRenderCommand(command))
+	{
+		delete command.modelUpdates;
+	}
+}
+
+glm::mat4* VulkanRenderer::mapModels()
+{
+	// the render thread owns the mapped arrays
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("mapModels() can't be used in render thread mode");
+	}
+
+	// the array of this frame may still be read by the frame that used it last time
+	graphicsTimeline.wait(frameTimelineValues[currentFrame]);
+
+	// what gets written can't be tracked, so a mapped frame is always drawn
+	modelsMapped = true;
+	redrawNeeded = true;
+	return mappedTransforms[currentFrame];
+}
+
+uint32_t VulkanRenderer::getModelCount()
+{
+	return static_cast<uint32_t>(modelTransforms.size());
+}
+
+MeshHandle VulkanRenderer::getMeshHandle(uint32_t index)
+{
+	return meshes.handleAt(index);
+}
+
+std::vector<MeshHandle> VulkanRenderer::loadScene(std::string fileName, MeshCreateFlags createFlags)
+{
+	// uploads go through the render thread's command pool, new meshes into its arrays
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("loadScene() can't be used in render thread mode");
+	}
+
+	// parse and convert on worker threads, nothing touches the device yet
+	SceneData scene = loadSceneFile("Models/" + fileName, &jobSystem);
+
+	// every texture and mesh buffer of the scene goes out in this one submission
+	UploadBatch uploadBatch(deviceMemoryInfo, mainDevice.logicalDevice, graphicsTimeline, graphicsCommandPool);
+
+	std::vector<TextureHandle> textureIds(scene.images.size());
+	for (size_t i = 0; i < scene.images.size(); i++)
+	{
+		textureIds[i] = createTexture(scene.images[i].pixels.data(), scene.images[i].width, scene.images[i].height, uploadBatch);
+	}
+
+	// buffers are made once per scene mesh, further instances of it draw from the first one's
+	std::vector<MeshHandle> sceneMeshIds(scene.meshes.size(), 0);
+	MeshOptimizationStatistics sceneStatistics;		// of all optimized meshes, weighted by triangle count
+	size_t optimizedTriangles = 0;
+	std::vector<MeshHandle> meshIds;
+	for (const SceneInstance& instance : scene.instances)
+	{
+		SceneMesh& sceneMesh = scene.meshes[instance.meshIndex];
+		if (sceneMesh.indices.empty())
+		{
+			continue;
+		}
+
+		MeshHandle& sceneMeshId = sceneMeshIds[instance.meshIndex];
+		if (sceneMeshId != 0)
+		{
+			meshIds.push_back(addMeshInstance(sceneMeshId, instance.transform));
+			continue;
+		}
+
+		MeshOptimizationStatistics statistics;
+		SharedMeshBuffers& shared = addMeshBuffers(createMeshBuffers(deviceMemoryInfo, mainDevice.logicalDevice, uploadBatch, &sceneMesh.vertices, &sceneMesh.indices, createFlags, &statistics));
+		sceneMeshId = addMesh(shared, textureIds[sceneMesh.imageIndex], instance.transform);
+		meshIds.push_back(sceneMeshId);
+
+		float triangles = float(sceneMesh.indices.size() / 3);
+		sceneStatistics.before.acmr += statistics.before.acmr * triangles;
+		sceneStatistics.before.atvr += statistics.before.atvr * triangles;
+		sceneStatistics.after.acmr += statistics.after.acmr * triangles;
+		sceneStatistics.after.atvr += statistics.after.atvr * triangles;
+		optimizedTriangles += sceneMesh.indices.size() / 3;
+	}
+
+	uploadBatch.submit();
+
+	// reported once per load, the numbers are only needed to see whether the optimizer paid off
+	if ((createFlags & MESH_CREATE_OPTIMIZE_BIT) && optimizedTriangles > 0)
+	{
+		float weight = 1.0f / float(optimizedTriangles);
+		printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%llu triangles optimized)\n", fileName.c_str(),
+			sceneStatistics.before.acmr * weight, sceneStatistics.after.acmr * weight,
+			sceneStatistics.before.atvr * weight, sceneStatistics.after.atvr * weight,
+			static_cast<unsigned long long>(optimizedTriangles));
+	}
+
+	return meshIds;
+}
+
+MeshHandle VulkanRenderer::addMeshInstance(MeshHandle mesh, const glm::mat4& model)
+{
+	// the arrays it grows belong to the render thread
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("addMeshInstance() can't be used in render thread mode");
+	}
+
+	Mesh* original = meshes.get(mesh);
+	if (!original)
+	{
+		throw std::runtime_error("addMeshInstance() of a mesh that doesn't exist");
+	}
+
+	// draws from the original's buffers, addMesh() counts it as one more user of them and the texture
+	return addMesh(meshBuffers[original->getVertexBuffer()], original->getTexId(), model);
+}
+
+void VulkanRenderer::removeMesh(MeshHandle mesh)
+{
+	// the arrays it reorders belong to the render thread
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("removeMesh() can't be used in render thread mode");
+	}
+
+	Mesh* removed = meshes.get(mesh);
+	if (!removed)
+	{
+		return;
+	}
+
+	// buffers go with the last mesh drawn from them, once the frames submitted so far (which may draw it) are done
+	VkBuffer vertexBuffer = removed->getVertexBuffer();
+	SharedMeshBuffers& shared = meshBuffers[vertexBuffer];
+	if (--shared.meshCount == 0)
+	{
+		shared.buffers.destroy(deletionQueue, graphicsTimeline.getLastValue());
+		meshBuffers.erase(vertexBuffer);
+	}
+
+	Texture* texture = textures.get(removed->getTexId());
+	if (texture && --texture->meshCount == 0)
+	{
+		destroyTexture(removed->getTexId());
+	}
+
+	// the last mesh moves into the hole, its per mesh data follows
+	uint32_t index = meshes.remove(mesh);
+	swapRemove(modelTransforms, index);
+	swapRemove(meshPipelines, index);
+
+	redrawNeeded = true;
+}
+
+void VulkanRenderer::setObjectDataMode(ObjectDataMode mode)
+{
+	// the render thread records with the pipeline it replaces
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("setObjectDataMode() can't be used in render thread mode");
+	}
+
+	if (mode == objectDataMode)
+	{
+		return;
+	}
+
+	objectDataMode = mode;
+	redrawNeeded = true;
+
+	// pipeline has the mode's vertex shader baked in, the layout is the same in both modes
+	// pipelines of the old mode stay in the registry, so switching back doesn't compile again
+	if (initialized)
+	{
+		defaultPipelineKey = pipelineRegistry.request(getDefaultPipelineState());
+		graphicsPipeline = pipelineRegistry.wait(defaultPipelineKey);
+	}
+}
+
+PipelineState VulkanRenderer::getDefaultPipelineState()
+{
+	PipelineState state = createDefaultPipelineState();
+
+	// vertex shader depends on where per object data comes from
+	if (objectDataMode == OBJECT_DATA_STORAGE_BUFFER)
+	{
+		state.vertexShader = "Shaders/vert_storage.spv";		// shader.vert built with OBJECT_DATA_STORAGE_BUFFER
+	}
+	else if (objectDataMode == OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER)
+	{
+		state.vertexShader = "Shaders/vert_dynamic.spv";		// shader.vert built with OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER
+	}
+
+	return state;
+}
+
+PipelineKey VulkanRenderer::requestPipeline(const PipelineState& state)
+{
+	return pipelineRegistry.request(state);
+}
+
+void VulkanRenderer::setMeshPipeline(MeshHandle mesh, PipelineKey pipelineKey, PipelineFallback fallback)
+{
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_SET_MESH_PIPELINE;
+	command.mesh = mesh;
+	command.key = pipelineKey;
+	command.value = fallback;
+	submitRenderCommand(command);
+}
+
+void VulkanRenderer::setLodErrorThreshold(float pixels)
+{
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_SET_LOD_ERROR_THRESHOLD;
+	command.scalar = pixels;
+	submitRenderCommand(command);
+}
+
+void VulkanRenderer::setView(const glm::mat4& newView)
+{
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_SET_VIEW;
+	command.matrix = newView;
+	submitRenderCommand(command);
+}
+
+void VulkanRenderer::setFramesInFlight(uint32_t count)
+{
+	// the per frame resources belong to the render thread
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("setFramesInFlight() can't be used in render thread mode");
+	}
+
+	count = std::max(count, 1u);
+	if (count == framesInFlight)
+	{
+		return;
+	}
+
+	// before init only the count changes, everything is created with it later
+	if (!initialized)
+	{
+		framesInFlight = count;
+		return;
+	}
+
+	// nothing of the old frames may still be in use, transform buffers keep their capacity
+	vkDeviceWaitIdle(mainDevice.logicalDevice);
+	uint32_t capacity = transformCapacity;
+	destroyFrameResources();
+
+	framesInFlight = count;
+	currentFrame = 0;
+	modelsMapped = false;
+
+	transformCapacity = capacity;
+	createFrameResources();
+	redrawNeeded = true;
+}
+
+void VulkanRenderer::setPresentPolicy(PresentPolicy policy)
+{
+	// the swapchain and the per frame resources belong to the render thread
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("setPresentPolicy() can't be used in render thread mode");
+	}
+
+	// nothing to rebuild, and a recreated swapchain would cost a redraw
+	if (policy == presentPolicy)
+	{
+		return;
+	}
+	presentPolicy = policy;
+
+	// low latency and power saving don't let the CPU run ahead, throughput keeps it busy while the GPU draws
+	setFramesInFlight(policy == PRESENT_POLICY_THROUGHPUT ? DEFAULT_FRAMES_IN_FLIGHT : 1);
+
+	// present mode and image count are fixed when the swapchain is created
+	if (initialized)
+	{
+		recreateSwapChain();
+		redrawNeeded = true;		// a new swapchain has nothing presented yet
+	}
+}
+
+void VulkanRenderer::beginFrame()
 {
-	if (modelId >= meshList.size()) return;
+	// taken here, not when the render thread gets to it
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_BEGIN_FRAME;
+	command.time = std::chrono::steady_clock::now();
+	submitRenderCommand(command);
+}
 
-	meshList[modelId].setModel(newModel);
+JobSystemStats VulkanRenderer::getJobStats()
+{
+	JobSystemStats stats = jobSystem.getStats();
+	jobSystem.resetStats();
+	return stats;
+}
+
+double VulkanRenderer::getFrameLatency()
+{
+	std::lock_guard<std::mutex> lock(latencyMutex);
+
+	double averageLatency = latencyCount > 0 ? latencySum / latencyCount : 0.0;
+
+	latencySum = 0.0;
+	latencyCount = 0;
+
+	return averageLatency;
+}
+
+void VulkanRenderer::pollEvents(double idleTimeout)
+{
+	// nothing to draw, sleep until the OS has something for us instead of spinning through empty frames
+	// (the timeout bounds how late changes made without any window event are picked up)
+	if (idle)
+	{
+		glfwWaitEventsTimeout(idleTimeout);
+	}
+	else
+	{
+		glfwPollEvents();
+	}
+}
+
+void VulkanRenderer::requestRedraw()
+{
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_REQUEST_REDRAW;
+	submitRenderCommand(command);
+}
+
+bool VulkanRenderer::isIdle()
+{
+	return idle;
+}
+
+void VulkanRenderer::windowRefreshCallback(GLFWwindow* refreshedWindow)
+{
+	static_cast<VulkanRenderer*>(glfwGetWindowUserPointer(refreshedWindow))->requestRedraw();
 }
 
 void VulkanRenderer::draw()
 {
-	// 0. wait for fences until it is open to draw
-	// 1. get next available image to draw to and set something to signal when wr're finished with the image( a semaphone)
-	// 2. submit command buffer to queue for execution, making sure it waits for the image to be signalled as available before drawing
+	if (!renderThread.joinable())
+	{
+		drawFrame();
+		return;
+	}
+
+	// counted before it's queued, the render thread may draw it right away
+	{
+		std::lock_guard<std::mutex> lock(renderThreadMutex);
+		queuedFrames++;
+	}
+
+	RenderCommand command = {};
+	command.type = RENDER_COMMAND_DRAW;
+	submitRenderCommand(command);
+
+	// the next frame may be simulated while this one is drawn, but not more than that
+	std::unique_lock<std::mutex> lock(renderThreadMutex);
+	renderThreadCondition.notify_one();
+	frameDrawnCondition.wait(lock, [this] { return queuedFrames <= 1 || renderThreadError; });
+
+	if (renderThreadError)
+	{
+		std::exception_ptr error = renderThreadError;
+		renderThreadError = nullptr;
+		lock.unlock();
+		std::rethrow_exception(error);
+	}
+}
+
+void VulkanRenderer::startRenderThread()
+{
+	if (renderThread.joinable())
+	{
+		return;
+	}
+
+	renderThreadStopping = false;
+	renderThreadError = nullptr;
+	queuedFrames = 0;
+	renderThread = std::thread(&VulkanRenderer::renderThreadLoop, this);
+}
+
+void VulkanRenderer::stopRenderThread()
+{
+	if (!renderThread.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(renderThreadMutex);
+		renderThreadStopping = true;
+	}
+	renderThreadCondition.notify_one();
+	renderThread.join();
+
+	// a failed render thread leaves its commands queued, batches still own their copy
+	RenderCommand command;
+	while (renderCommands.pop(command))
+	{
+		if (command.type == RENDER_COMMAND_UPDATE_MODELS)
+		{
+			delete command.modelUpdates;
+		}
+	}
+
+	// failed after the last draw(), nothing else would report it
+	if (renderThreadError)
+	{
+		std::exception_ptr error = renderThreadError;
+		renderThreadError = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+bool VulkanRenderer::submitRenderCommand(const RenderCommand& command)
+{
+	if (!renderThread.joinable())
+	{
+		applyRenderCommand(command);
+		return true;
+	}
+
+	// full: make sure the render thread is awake and wait for room instead of dropping the change
+	while (!renderCommands.push(command))
+	{
+		{
+			std::lock_guard<std::mutex> lock(renderThreadMutex);
+			if (renderThreadError)
+			{
+				return false;		// render thread is gone, draw() reports why
+			}
+		}
+		renderThreadCondition.notify_one();
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+void VulkanRenderer::applyRenderCommand(const RenderCommand& command)
+{
+	// dense index of the mesh the command is for, INVALID_SLOT_INDEX once it was removed
+	uint32_t meshIndex = meshes.indexOf(command.mesh);
+
+	switch (command.type)
+	{
+	case RENDER_COMMAND_UPDATE_MODEL:
+		// setting the same matrix again every frame doesn't keep the renderer busy
+		if (meshIndex != INVALID_SLOT_INDEX && modelTransforms[meshIndex] != command.matrix)
+		{
+			modelTransforms[meshIndex] = command.matrix;
+			redrawNeeded = true;
+		}
+		break;
+
+	case RENDER_COMMAND_UPDATE_MODELS:
+		// only queued in render thread mode
+		for (const ModelUpdate& update : *command.modelUpdates)
+		{
+			uint32_t updateIndex = meshes.indexOf(update.mesh);
+			if (updateIndex != INVALID_SLOT_INDEX && modelTransforms[updateIndex] != update.model)
+			{
+				modelTransforms[updateIndex] = update.model;
+				redrawNeeded = true;
+			}
+		}
+		delete command.modelUpdates;
+		break;
+
+	case RENDER_COMMAND_SET_VIEW:
+		if (uboViewProjection.view != command.matrix)
+		{
+			uboViewProjection.view = command.matrix;
+			viewProjectionGeneration++;
+			redrawNeeded = true;
+		}
+		break;
+
+	case RENDER_COMMAND_SET_MESH_PIPELINE:
+		if (meshIndex != INVALID_SLOT_INDEX)
+		{
+			meshPipelines[meshIndex].key = command.key;
+			meshPipelines[meshIndex].fallback = static_cast<PipelineFallback>(command.value);
+			redrawNeeded = true;
+		}
+		break;
+
+	case RENDER_COMMAND_SET_LOD_ERROR_THRESHOLD:
+		lodErrorThreshold = command.scalar;
+		redrawNeeded = true;
+		break;
+
+	case RENDER_COMMAND_REQUEST_REDRAW:
+		redrawNeeded = true;
+		break;
+
+	case RENDER_COMMAND_BEGIN_FRAME:
+		nextFrameBegin = command.time;
+		frameBegun = true;
+		break;
+
+	case RENDER_COMMAND_DRAW:
+		// only queued in render thread mode
+		drawFrame();
+		{
+			std::lock_guard<std::mutex> lock(renderThreadMutex);
+			queuedFrames--;
+		}
+		frameDrawnCondition.notify_all();
+		break;
+	}
+}
+
+void VulkanRenderer::renderThreadLoop()
+{
+	try
+	{
+		RenderCommand command;
+		while (true)
+		{
+			if (renderCommands.pop(command))
+			{
+				applyRenderCommand(command);
+				continue;
+			}
+
+			// out of commands, sleep until the next frame is queued
+			std::unique_lock<std::mutex> lock(renderThreadMutex);
+			if (renderThreadStopping && renderCommands.empty())
+			{
+				break;
+			}
+			renderThreadCondition.wait(lock, [this] { return !renderCommands.empty() || renderThreadStopping; });
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(renderThreadMutex);
+		renderThreadError = std::current_exception();
+		frameDrawnCondition.notify_all();
+	}
+}
+
+void VulkanRenderer::drawFrame()
+{
+	// nothing changed since the last frame, the image on screen is still current
+	idle = !redrawNeeded;
+	if (idle)
+	{
+		frameBegun = false;
+		return;
+	}
+	redrawNeeded = false;		// recording may set it again (pipelines still compiling)
+
+	// 0. wait for the timeline to reach the value of this frame's last submission
+	// 1. update buffers and record all draws of this frame, none of it depends on which swapchain image is drawn to
+	// 2. get next available image to draw to and set something to signal when wr're finished with the image( a semaphone)
+	//	(as late as possible, so the CPU work above never waits behind the presentation engine)
+	// 3. submit command buffer to queue for execution, making sure it waits for the image to be signalled as available before drawing
 	//	and signals when it has finished rendering
-	// 3. present image to screen when it has signalled finished rendering
+	// 4. present image to screen when it has signalled finished rendering
+
+	std::chrono::steady_clock::time_point drawBegin = std::chrono::steady_clock::now();
+
+	// frames the GPU finished since the last draw
+	measureFrameLatency(graphicsTimeline.getCompletedValue());
+
+	// wait for the GPU to finish the last submission that used this frame's resources (nothing to reset, values only grow)
+	graphicsTimeline.wait(frameTimelineValues[currentFrame]);
+	measureFrameLatency(frameTimelineValues[currentFrame]);
+
+	// transient sets and data of this frame's last use are no longer read by the GPU
+	frameDescriptorAllocators[currentFrame].reset();
+	frameAllocators[currentFrame].reset();
+	writeFrameDescriptorSets();
 
-	// wait for given fence to signal (open) from last draw before continuing
-	vkWaitForFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-	// manully reset (close) the fences
-	vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]);
+	// resources removed while earlier frames were in flight, as far as those frames are done
+	deletionQueue.collect(graphicsTimeline.getCompletedValue());
+
+	// -- CPU WORK OF THE FRAME --
+	updateTransformBuffer();
+	updateUniformBuffers();
+	recordCommands();
 
 	// -- GET NEXT IMAGE--
 	// get index of next image to be drawn to, and signal semaphore when ready to be drawn to
 	uint32_t imageIndex;
-	vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	VkResult result = vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		// nothing was acquired and the semaphore won't be signalled, so nothing may be submitted: draw the frame again next time
+		recreateSwapChain();
+		redrawNeeded = true;
+		return;
+	}
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	{
+		throw std::runtime_error("Faild to acquire a swapchain image");
+	}
+
+	// the only part that needs the image: render pass on its framebuffer, running the recorded draws
+	recordRenderPass(imageIndex);
 
-	recordCommands(imageIndex);
-	updateUniformBuffers(imageIndex);
+	// everything written to the frame allocator this frame, in one range
+	frameAllocators[currentFrame].flush();
 
 	// -- SUBMIT COMMAND BUFFER TO RENDER --
-	// Queue submission information
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;													// number of semaphores to wait on
-	submitInfo.pWaitSemaphores = &imageAvailable[currentFrame];								// list of semaphores to wait on
-	VkPipelineStageFlags waitStages[] = {
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-	};
-	submitInfo.pWaitDstStageMask = waitStages;									// stages to check semaphores at
-	submitInfo.commandBufferCount = 1;												// number of command buffers to submit
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];	// command buffer to submit
-	submitInfo.signalSemaphoreCount = 1;												// number of semaphores to signal
-	submitInfo.pSignalSemaphores = &renderFinished[currentFrame];							// semaphores to signal when command buffer finishes
-
-	// submit command buffer to queue
-	VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, drawFences[currentFrame]);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("faild to submid command buffer to queue");
-	}
+	// acquire and present still need binary semaphores, the timeline value tells when this frame is done
+	TimelineSubmit timelineSubmit = {};
+	timelineSubmit.commandBufferCount = 1;											// number of command buffers to submit
+	timelineSubmit.pCommandBuffers = &commandBuffers[currentFrame];					// command buffer to submit
+	timelineSubmit.waitSemaphore = imageAvailable[currentFrame];					// semaphore to wait on
+	timelineSubmit.waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;		// stage to check semaphore at
+	timelineSubmit.signalSemaphore = swapChainImages[imageIndex].renderFinished;	// semaphore to signal when command buffer finishes
+
+	// submit command buffer to queue, remember the value it signals
+	frameTimelineValues[currentFrame] = graphicsTimeline.submit(timelineSubmit);
+
+	frameTimings[currentFrame].begin = frameBegun ? nextFrameBegin : drawBegin;
+	frameTimings[currentFrame].pending = true;
+	frameBegun = false;
 
 	// -- PRESENT RENDERED IMAGE TO SCREEN --
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;								// number of semaphores to wait on
-	presentInfo.pWaitSemaphores = &renderFinished[currentFrame];				// semaphores to wait on
+	presentInfo.pWaitSemaphores = &swapChainImages[imageIndex].renderFinished;	// semaphores to wait on
 	presentInfo.swapchainCount = 1;										// number of swapchains to present to
 	presentInfo.pSwapchains = &swapchain;							// swapchains to present images to
 	presentInfo.pImageIndices = &imageIndex;						// Index of images in swapchains to present
 
-	// present image
+	// present image, a swapchain that no longer matches the surface is rebuilt (the image was presented anyway or is lost)
 	result = vkQueuePresentKHR(presentationQueue, &presentInfo);
-	if (result != VK_SUCCESS)
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+	{
+		recreateSwapChain();
+		redrawNeeded = true;
+	}
+	else if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("faild to present image");
 	}
 
-	// get next frame( use % MAX_FRAME_DRAWS to keep balue below MAX_FRAME_DRAWS)
-	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+	// get next frame( use % framesInFlight to keep balue below framesInFlight)
+	currentFrame = (currentFrame + 1) % framesInFlight;
+	modelsMapped = false;
 }
 
 // whenever the vkCreate*() is called, there also needs a destroy function to be called in cleanup()
 void VulkanRenderer::cleanup()
 {
+	stopRenderThread();
+	jobSystem.destroy();
+
 	// wait until no actions being run on device before destroying
 	vkDeviceWaitIdle(mainDevice.logicalDevice);
 
-	//_aligned_free(modelTransferSpace);
-
-	vkDestroyDescriptorPool(mainDevice.logicalDevice, samplerDescriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, samplerSetLayout, nullptr);
+	destroyFrameResources();
 
-	vkDestroySampler(mainDevice.logicalDevice, textureSampler, nullptr);
+	// the ones still in use (and any a scene loaded without a mesh drawing them)
+	while (!textures.empty())
+	{
+		destroyTexture(textures.handleAt(0));
+	}
 
-	for (size_t i = 0; i < textureImages.size(); i++)
+	// instances share buffers, each set is destroyed once
+	for (auto& shared : meshBuffers)
 	{
-		vkDestroyImageView(mainDevice.logicalDevice, textureImageViews[i], nullptr);
-		vkDestroyImage(mainDevice.logicalDevice, textureImages[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, textureImageMemory[i], nullptr);
+		shared.second.buffers.destroy(deletionQueue, 0);
 	}
+	meshBuffers.clear();
+
+	// device is idle, everything queued goes now (texture sets before their allocator)
+	deletionQueue.destroy();
+
+	textureDescriptorAllocator.destroy();
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, samplerSetLayout, nullptr);
+
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, objectSetLayout, nullptr);
+
+	vkDestroySampler(mainDevice.logicalDevice, textureSampler, nullptr);
 
 	vkDestroyImageView(mainDevice.logicalDevice, depthBufferImageView, nullptr);
 	vkDestroyImage(mainDevice.logicalDevice, depthBufferImage, nullptr);
 	vkFreeMemory(mainDevice.logicalDevice, depthBufferImageMemory, nullptr);
 
-	vkDestroyDescriptorPool(mainDevice.logicalDevice, descriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, descriptorSetLayout, nullptr);
-	for (size_t i = 0; i < swapChainImages.size(); i++)
-	{
-		vkDestroyBuffer(mainDevice.logicalDevice, vpUniformBuffer[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, vpUniformBufferMemory[i], nullptr);
-
-		//vkDestroyBuffer(mainDevice.logicalDevice, mDynamicUniformBuffer[i], nullptr);
-		//vkFreeMemory(mainDevice.logicalDevice, mDynamicUniformBufferMemory[i], nullptr);
-	}
-	for (size_t i = 0; i < meshList.size(); i++)
-	{
-		meshList[i].destroyBuffers();
-	}
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
-	{
-		vkDestroySemaphore(mainDevice.logicalDevice, renderFinished[i], nullptr);
-		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
-		vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
-	}
+	graphicsTimeline.destroy();
 	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
-	for (auto framebuffer : swapChainFramebuffers) {
-		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
-	}
-	vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
+	destroySwapChain();
+	pipelineRegistry.destroy();		// also destroys graphicsPipeline
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
+
+	// keep compiled pipelines for the next launch
+	savePipelineCache(mainDevice.logicalDevice, pipelineCache, PIPELINE_CACHE_FILE);
+	vkDestroyPipelineCache(mainDevice.logicalDevice, pipelineCache, nullptr);
+
 	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
-	for (auto image : swapChainImages)
-	{
-		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
-	}
-	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
 	vkDestroySurfaceKHR(instance, surface, nullptr);
 	vkDestroyDevice(mainDevice.logicalDevice, nullptr);
 	vkDestroyInstance(instance, nullptr);
@@ -217,7 +854,7 @@ void VulkanRenderer::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0); //custom version of the application
 	appInfo.pEngineName = "No Engine";					  //custom engine name
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);	 //custom engine version
-	appInfo.apiVersion = VK_API_VERSION_1_0;			// the Vulkan Version
+	appInfo.apiVersion = VK_API_VERSION_1_2;			// the Vulkan Version (1.2 for timeline semaphores)
 
 
 	//creation infomation for a VkInstance
@@ -291,8 +928,31 @@ void VulkanRenderer::createLogicalDevice()
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());				//number of queue create infos
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();										//list of queue create info so device can create required queues
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());			//number of enabled logical device extensions
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();									//list of enabled logical device extensions
+
+	// required extensions + optional ones the device has
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+
+	// timeline semaphores (frame pacing and upload waits), checked for in checkDeviceSuitable
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
+	timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+	deviceCreateInfo.pNext = &timelineSemaphoreFeatures;
+
+	// graphics pipeline libraries (pipelines linked from separately compiled parts)
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures = {};
+	graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+	graphicsPipelineLibrarySupported = checkGraphicsPipelineLibrarySupport(mainDevice.physicalDevice);
+	if (graphicsPipelineLibrarySupported)
+	{
+		enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+		timelineSemaphoreFeatures.pNext = &graphicsPipelineLibraryFeatures;
+	}
+
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());			//number of enabled logical device extensions
+	deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();									//list of enabled logical device extensions
 
 	// physical device features the logacal device will be using
 	VkPhysicalDeviceFeatures deviceFeatures = {};
@@ -312,6 +972,9 @@ void VulkanRenderer::createLogicalDevice()
 	// from given logical device, of given queue family, of given queue index (0 since only one queue), place reference in given VkQueue
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+
+	// one timeline for everything submitted to the graphics queue (frames and uploads)
+	graphicsTimeline.create(mainDevice.logicalDevice, graphicsQueue);
 }
 
 void VulkanRenderer::createSurface()
@@ -335,16 +998,7 @@ void VulkanRenderer::createSwapChain()
 	VkPresentModeKHR presentMode = chooseBestPresentationMode(swapChainDetails.presentationModes);
 	VkExtent2D extent = chooseSwapExtent(swapChainDetails.surfaceCapabilities);
 
-	//how many images are in the swapchain? get 1 more than the minimum to allow triple buffering
-	uint32_t imageCount = swapChainDetails.surfaceCapabilities.minImageCount + 1;
-
-	// if imageCount higher than max, then clamp down to max
-	// if 0, then limitless
-	if (swapChainDetails.surfaceCapabilities.maxImageCount > 0
-		&& swapChainDetails.surfaceCapabilities.maxImageCount < imageCount)
-	{
-		imageCount = swapChainDetails.surfaceCapabilities.maxImageCount;
-	}
+	uint32_t imageCount = chooseSwapImageCount(swapChainDetails.surfaceCapabilities);
 
 	//creation information for swap chain
 	VkSwapchainCreateInfoKHR swapChainCreateInfo = {};
@@ -403,18 +1057,33 @@ void VulkanRenderer::createSwapChain()
 	std::vector<VkImage> images(swapChainImageCount);
 	vkGetSwapchainImagesKHR(mainDevice.logicalDevice, swapchain, &swapChainImageCount, images.data());
 
+	// one present semaphore per image, not per frame in flight: a present may still wait on the semaphore of its image
+	// when the next frame is submitted, the frame's timeline value doesn't cover that wait
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
 	for (VkImage image : images)
 	{
 		// store iamge handle
 		SwapchainImage swapChainImage = {};
 		swapChainImage.image = image;
 		swapChainImage.imageView = createImageView(image, swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &swapChainImage.renderFinished) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Faild to create a semaphore");
+		}
 
 		//add to swapchain image list
 		swapChainImages.push_back(swapChainImage);
 	}
 }
 
+void VulkanRenderer::createPipelineCache()
+{
+	// compiled pipelines of the last run, so shaders don't have to be compiled from scratch on every launch
+	pipelineCache = loadPipelineCache(mainDevice.physicalDevice, mainDevice.logicalDevice, PIPELINE_CACHE_FILE);
+}
+
 void VulkanRenderer::createRenderPass()
 {
 	// ATTACHMENTS
@@ -522,15 +1191,16 @@ void VulkanRenderer::createDescriptorSetLayout()
 	vpLayoutBinding.descriptorCount = 1;																		// number of descriptors for binding
 	vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;								// shader stage to bind to
 	vpLayoutBinding.pImmutableSamplers = nullptr;														// for texture: can make sampler data unchangeable ( immutable) by specifying in layout
-	/*
+
+	// Model Binding Info (dynamic uniform buffer mode, one offset per draw into the frame allocator)
 	VkDescriptorSetLayoutBinding mLayoutBinding = {};
 	mLayoutBinding.binding = 1;
 	mLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	mLayoutBinding.descriptorCount = 1;
 	mLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	mLayoutBinding.pImmutableSamplers = nullptr;
-	*/
-	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding/*, mLayoutBinding*/};
+
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding, mLayoutBinding };
 
 	// create descriptor set layout with given bindings
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
@@ -566,6 +1236,26 @@ void VulkanRenderer::createDescriptorSetLayout()
 	{
 		throw std::runtime_error("failed to create a descriptor set layout");
 	}
+
+	// CREATE OBJECT DATA DESCRIPTOR SET LAYOUT
+	// model matrices, indexed by instance in the vertex shader
+	VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+	objectLayoutBinding.binding = 0;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	objectLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutCreateInfo objectLayoutCreateInfo = {};
+	objectLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	objectLayoutCreateInfo.bindingCount = 1;
+	objectLayoutCreateInfo.pBindings = &objectLayoutBinding;
+
+	result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &objectLayoutCreateInfo, nullptr, &objectSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create a descriptor set layout");
+	}
 }
 
 void VulkanRenderer::createPushConstantRange()
@@ -578,157 +1268,9 @@ void VulkanRenderer::createPushConstantRange()
 
 void VulkanRenderer::createGraphicsPipeline()
 {
-	// read in SPIR_V code of shaders
-	auto vertexShaderCode = readFile("Shaders/vert.spv");
-	auto fragmentShaderCode = readFile("Shaders/frag.spv");
-
-	// create shader modules
-	VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
-
-	// -- SHADER STAGE CREATION INFORMATION --
-	// Vertex Stage creation information
-	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;			// shader stage name
-	vertexShaderCreateInfo.module = vertexShaderModule;					// shader module to be used by stage
-	vertexShaderCreateInfo.pName = "main";								// engry point in to shader ("main" function in shader.vert)
-
-	// Fragment Stage creation information
-	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;			// shader stage name
-	fragmentShaderCreateInfo.module = fragmentShaderModule;					// shader module to be used by stage
-	fragmentShaderCreateInfo.pName = "main";								// engry point in to shader ("main" function in shader.vert)
-
-	// put shader stage creation info in to array
-	// graphics pipeline creation info requires array of shader stage creates
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
-
-	// how the data for a single vertex (including info such as position, color, texture, coords, normals, etc) is as a whole
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;																// can bind multiple streams of data, this defines which one
-	bindingDescription.stride = sizeof(Vertex);												// size of a single vertex object
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;		// how to move between data after each vertex
-	// VK_VERTEX_INPUT_RATE_VERTEX		:	move on to the next vertex (of the same object)
-	// VK_VERTEX_INPUT_RATE_INSTANCE	:	move to a vertex for the next (object)
-
-// how the data for an attribute is define within a vertex
-	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions;
-
-	// position attribute
-	attributeDescriptions[0].binding = 0;														// which binding the data is at (should be same as above)
-	attributeDescriptions[0].location = 0;														// location in shader where data will be read from
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;		// format the data will take (also helps define size of data)
-	attributeDescriptions[0].offset = offsetof(Vertex, pos);							// where this attribute is define in the data for a single vertex
-
-	// color attribute
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, col);
-
-	// texture attribute
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, tex);
-
-	// -- VERTEX INPUT --
-	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;					// list of vertex binding descritions (data spacing/stride information)
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();		// list of vertex attribute descriptions (data format and where to bind to/from)
-
-	// -- INPUT ASSEMBLY --
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;	// primitive type to assemble vertices as
-	inputAssembly.primitiveRestartEnable = VK_FALSE;				// allow overriding of "strip" topology to start new primitives
-
-	// -- VIEWPORT & SCISSOR --
-	// create a viewport info struct
-	VkViewport viewport = {};
-	viewport.x = 0.0f;									// x start coordinate
-	viewport.y = 0.0f;									// y start coordinate
-	viewport.width = (float)swapChainExtent.width;		// width of viewport
-	viewport.height = (float)swapChainExtent.height;	// height of viewport
-	viewport.minDepth = 0.0f;							// min framebuffer depth
-	viewport.maxDepth = 1.0f;							// max framebuffer depth
-
-	// create a scissor info struct
-	VkRect2D scissor = {};
-	scissor.offset = { 0, 0 };							// offset to use region from
-	scissor.extent = swapChainExtent;					// extent to describe region to use, starting at offset
-
-	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.pViewports = &viewport;
-	viewportStateCreateInfo.scissorCount = 1;
-	viewportStateCreateInfo.pScissors = &scissor;
-
-	// -- DYNAMIC STATES --
-	// if resizing the window, also recreate the swap chain and swap chain images and any images associated with output to the swap chain
-	//// Dynamic States to enable
-	//std::vector<VkDynamicState> dynamicStateEnables;
-	//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);	// Dynamic Viewport : Can resize in command buffer with vkCmdSetViewport(commandbuffer, 0, 1, &viewport)
-	//dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// Dynamic Scissor	: Can resize in command buffer with vkCmdSetScissor (commandbuffer, 0, 1, &scrissor)
-	//
-	//// Dynamic State Creation info
-	//VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
-	//dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	//dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-	//dynamicStateCreateInfo.pDynamicStates = dynamicStateEnables.data();
-
-	// -- RASTERIZER --
-	VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizerCreateInfo.depthClampEnable = VK_FALSE;			// change if fragments beyond near/far planes are clipped (default) or clamped to plane (read:https://blog.csdn.net/yangyong0717/article/details/78321968)
-	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;	// whether to discard data and skip rasterizer. never creates fragments, only suitable for pipeline without framebuffer output
-	rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;	// how to handle filling points between vertices
-	rasterizerCreateInfo.lineWidth = 1.0f;						// how thick lines should be when drawn
-	rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;		// which faceof a tri to cull
-	rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;	// winding to determine wichi side is front
-	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;			// whether to add depth bias to framents (good for stopping "shadow acne" in shadow mapping)
-
-	// -- MULTISAMPLING --
-	VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
-	multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;					// enable multisample shading or not
-	multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;	// number of sample to use per fragment
-
-	// -- BLENDING --
-	// bleding decides how to blend a new color being written to a fragment, with the old value
-
-	// blend attachment state (how blending is handled)
-	VkPipelineColorBlendAttachmentState colorState = {};
-	colorState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;		// colors to apply blending to
-	colorState.blendEnable = VK_TRUE;								// enable blending
-
-	//blending uses equation: (srcColorBlendFactor * new color) colorBlendOp (dstColorblendFactor * old color)
-	colorState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colorState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colorState.colorBlendOp = VK_BLEND_OP_ADD;
-	// summarised: (VK_BLEND_FACTOR_SRC_ALPHA * new color) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * old color)
-	//				(new color alpha * new color) + ((1 - new color alpha) * old color)
-
-	colorState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorState.alphaBlendOp = VK_BLEND_OP_ADD;
-	// summerised: (1 * new alpha) + (0 * old alpha) = new alpha
-
-	VkPipelineColorBlendStateCreateInfo colorBlendingCreateInfo = {};
-	colorBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlendingCreateInfo.logicOpEnable = VK_FALSE;			// alternative to calculations is to use logical operations
-	colorBlendingCreateInfo.attachmentCount = 1;
-	colorBlendingCreateInfo.pAttachments = &colorState;
-
 	// -- PIPELINE LAYOUT --
-	std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = { descriptorSetLayout, samplerSetLayout };
+	// same layout in both object data modes, unused parts are simply not read by the shader
+	std::array<VkDescriptorSetLayout, 3> descriptorSetLayouts = { descriptorSetLayout, samplerSetLayout, objectSetLayout };
 
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -744,46 +1286,14 @@ void VulkanRenderer::createGraphicsPipeline()
 		throw std::runtime_error("Faild to create Pipeline Layout!");
 	}
 
-	// -- DEPTH STENCIL TESTING --
-	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
-	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencilCreateInfo.depthTestEnable = VK_TRUE;								// enable checking depth to determin fragment write
-	depthStencilCreateInfo.depthWriteEnable = VK_TRUE;							// enable writing wo depth buffer( to replace old values)
-	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;	// comparison operation that allows an overwrite (is in front)
-	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;				// depth bounds test: does the depth value exist between two bounds
-	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;							// enable stencil test
-
-	// -- GRAPHICS PIPELINE CREATION --
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = 2;									// number of shader stages
-	pipelineCreateInfo.pStages = shaderStages;							// list of shader stages
-	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;		// all the fixed function pipeline stages
-	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
-	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
-	pipelineCreateInfo.pColorBlendState = &colorBlendingCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
-	pipelineCreateInfo.layout = pipelineLayout;							// pipeline layout pipeline shoudld use
-	pipelineCreateInfo.renderPass = renderPass;							// render pass description the pipeline is compatible with
-	pipelineCreateInfo.subpass = 0;										// subpass of render pass to use with pipeline
-	// pipeline derivatives : can create multiple pipeline that derive from one another for optimization
-	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;				// existing pipeline to derive from...
-	pipelineCreateInfo.basePipelineIndex = -1;							// or index of pipeline being created to derive from ( in case creating multiple at once)
-
-	// create graphics pipeline
-	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("faild to create a graphics pipeline!");
-	}
-
-	// destroy shader modules, no longer needed after pipeline created
-	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
+	// every pipeline shares layout, render pass and cache, so the registry only needs the state that differs
+	// half the cores compile in the background, the rest stay free for the frame loop
+	uint32_t workerCount = std::max(std::thread::hardware_concurrency() / 2, 1u);
+	pipelineRegistry.init(mainDevice.logicalDevice, pipelineCache, pipelineLayout, renderPass, workerCount, graphicsPipelineLibrarySupported);
 
+	// default pipeline is the fallback for every other one, so it has to exist before the first frame
+	defaultPipelineKey = pipelineRegistry.request(getDefaultPipelineState());
+	graphicsPipeline = pipelineRegistry.wait(defaultPipelineKey);
 }
 
 void VulkanRenderer::createDepthBufferImage()
@@ -796,7 +1306,7 @@ void VulkanRenderer::createDepthBufferImage()
 	);
 
 	// create depth buffer image
-	depthBufferImage = createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthBufferImageMemory);
+	depthBufferImage = createImage(swapChainExtent.width, swapChainExtent.height, 1, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthBufferImageMemory);
 
 	// create depth buffer image view
 	depthBufferImageView = createImageView(depthBufferImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
@@ -852,8 +1362,9 @@ void VulkanRenderer::createCommandPool()
 
 void VulkanRenderer::createCommandBuffers()
 {
-	// resize command buffer count to have one for each framebuffer
-	commandBuffers.resize(swapChainFramebuffers.size());
+	// one for each frame in flight, so recording never waits for a swapchain image
+	commandBuffers.resize(framesInFlight);
+	sceneCommandBuffers.resize(framesInFlight);
 
 	VkCommandBufferAllocateInfo cbAllocInfo = {}; //command buffer already exist in memory, only allocate a command buffer from the pool instead of creating a piece in place in memory for them
 	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -868,30 +1379,31 @@ void VulkanRenderer::createCommandBuffers()
 	{
 		throw std::runtime_error("faild to allocate command buffers");
 	}
+
+	// draws go in secondaries, they can be recorded inside a render pass without knowing its framebuffer
+	cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &cbAllocInfo, sceneCommandBuffers.data());
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("faild to allocate command buffers");
+	}
 }
 
 void VulkanRenderer::createSynchronization()
 {
-	imageAvailable.resize(MAX_FRAME_DRAWS);
-	renderFinished.resize(MAX_FRAME_DRAWS);
-	drawFences.resize(MAX_FRAME_DRAWS);
+	imageAvailable.resize(framesInFlight);
+	frameTimelineValues.assign(framesInFlight, 0);		// 0 = never submitted, waiting for it returns at once
+	frameTimings.assign(framesInFlight, FrameTiming());
 
 	// semaphore creation information
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	// fence creation information
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	for (size_t i = 0; i < framesInFlight; i++)
 	{
-		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderFinished[i]) != VK_SUCCESS ||
-			vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &drawFences[i]))
+		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS)
 		{
-			throw std::runtime_error("Faild to create a semaphore and/or fence");
+			throw std::runtime_error("Faild to create a semaphore");
 		}
 	}
 }
@@ -922,186 +1434,376 @@ void VulkanRenderer::createTextureSampler()
 	}
 }
 
+void VulkanRenderer::createTextureDescriptorAllocator()
+{
+	// texture sets only hold one combined image sampler, pools are chained as textures get added
+	textureDescriptorAllocator.init(mainDevice.logicalDevice, { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f } });
+}
+
+void VulkanRenderer::createFrameResources()
+{
+	createCommandBuffers();
+	createUniformBuffers();
+	createTransformBuffers(transformCapacity > 0 ? transformCapacity : MAX_OBJECTS);
+	createFrameAllocators();
+	createFrameDescriptorAllocators();
+	createSynchronization();
+}
+
 void VulkanRenderer::createUniformBuffers()
 {
 	// ViewProjection buffer size
 	VkDeviceSize vpBufferSize = sizeof(UboViewProjection);
 
-	// Model buffer size
-	//VkDeviceSize modelBufferSize = modelUniformAlignment * MAX_OBJECTS;
-
-	// one uniform for each image( and by extension, command buffer)
-	vpUniformBuffer.resize(swapChainImages.size());
-	vpUniformBufferMemory.resize(swapChainImages.size());
-	//mDynamicUniformBuffer.resize(swapChainImages.size());
-	//mDynamicUniformBufferMemory.resize(swapChainImages.size());
+	// one uniform for each frame in flight( and by extension, command buffer)
+	vpUniformBuffer.resize(framesInFlight);
+	vpUniformBufferMemory.resize(framesInFlight);
+	mappedViewProjections.resize(framesInFlight);
+	vpUniformGenerations.assign(framesInFlight, 0);		// new buffers hold nothing yet
 
 	// create uniform buffers
-	for (size_t i = 0; i < swapChainImages.size(); i++)
+	// any host visible memory will do, coherent or not (non-coherent writes are flushed in updateUniformBuffers)
+	// GPU memory the CPU can write to is preferred (integrated GPUs, resizable BAR)
+	VkMemoryPropertyFlags memoryProperties = 0;
+	for (size_t i = 0; i < framesInFlight; i++)
 	{
-		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, vpBufferSize,
+		memoryProperties = createBuffer(deviceMemoryInfo, mainDevice.logicalDevice, vpBufferSize,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&vpUniformBuffer[i], &vpUniformBufferMemory[i]);
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			&vpUniformBuffer[i], &vpUniformBufferMemory[i], BUFFER_MEMORY_DIRECT_WRITE_BIT);
 
-		/*createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, modelBufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		// map once and keep it mapped for the lifetime of the buffer
+		void* data;
+		vkMapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[i], 0, vpBufferSize, 0, &data);
+		mappedViewProjections[i] = static_cast<UboViewProjection*>(data);
+	}
+
+	// all the same size and usage, so all in the same kind of memory
+	vpUniformMemoryCoherent = (memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+void VulkanRenderer::createFrameAllocators()
+{
+	// one buffer per frame in flight, the CPU fills one while the GPU may still read the others
+	// with room for every model matrix at its dynamic uniform buffer stride on top, sized with the transform buffers
+	VkDeviceSize capacity = FRAME_ALLOCATOR_CAPACITY + modelUniformAlignment * transformCapacity;
+
+	frameAllocators.resize(framesInFlight);
+	for (FrameAllocator& frameAllocator : frameAllocators)
+	{
+		frameAllocator.init(mainDevice.physicalDevice, deviceMemoryInfo, mainDevice.logicalDevice, capacity);
+	}
+}
+
+void VulkanRenderer::createTransformBuffers(uint32_t capacity)
+{
+	VkDeviceSize transformBufferSize = sizeof(glm::mat4) * capacity;
+
+	transformBuffer.resize(framesInFlight);
+	transformBufferMemory.resize(framesInFlight);
+	mappedTransforms.resize(framesInFlight);
+
+	// one per frame in flight, so the CPU writes one array while the GPU may still read the others
+	// (kept out of GPU memory even where the CPU could write there: a frame written through mapModels() is read back into
+	// modelTransforms, which is slow from uncached memory, recording itself only reads modelTransforms)
+	for (size_t i = 0; i < framesInFlight; i++)
+	{
+		createBuffer(deviceMemoryInfo, mainDevice.logicalDevice, transformBufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&mDynamicUniformBuffer[i], &mDynamicUniformBufferMemory[i]);*/
+			&transformBuffer[i], &transformBufferMemory[i]);
+
+		// map once and keep it mapped for the lifetime of the buffer
+		void* data;
+		vkMapMemory(mainDevice.logicalDevice, transformBufferMemory[i], 0, transformBufferSize, 0, &data);
+		mappedTransforms[i] = static_cast<glm::mat4*>(data);
+	}
+
+	transformCapacity = capacity;
+}
+
+void VulkanRenderer::createFrameDescriptorAllocators()
+{
+	// per frame allocators for the sets of one frame (view projection + dynamic model set, object data set),
+	// pools are only created on first use
+	frameDescriptorAllocators.resize(framesInFlight);
+	for (DescriptorAllocator& frameDescriptorAllocator : frameDescriptorAllocators)
+	{
+		frameDescriptorAllocator.init(mainDevice.logicalDevice, {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f } });
+	}
+
+	descriptorSets.assign(framesInFlight, VK_NULL_HANDLE);
+	objectDescriptorSets.assign(framesInFlight, VK_NULL_HANDLE);
+}
+
+void VulkanRenderer::writeFrameDescriptorSets()
+{
+	// allocated fresh from the frame's allocator (just reset), so they always point at the current buffers,
+	// growing the transform buffers or frame allocators never has to go back and rewrite sets
+	descriptorSets[currentFrame] = frameDescriptorAllocators[currentFrame].allocate(descriptorSetLayout);
+
+	// VIEW PROJECTION DESCRIPTOR
+	VkDescriptorBufferInfo vpBufferInfo = {};
+	vpBufferInfo.buffer = vpUniformBuffer[currentFrame];		// buffer to get data from
+	vpBufferInfo.offset = 0;									// poition of start of data
+	vpBufferInfo.range = sizeof(UboViewProjection);				// size of data
+
+	// MODEL DESCRIPTOR
+	// the range is one model, each draw moves it with its dynamic offset
+	VkDescriptorBufferInfo mBufferInfo = {};
+	mBufferInfo.buffer = frameAllocators[currentFrame].getBuffer();
+	mBufferInfo.offset = 0;
+	mBufferInfo.range = sizeof(Model);
+
+	std::array<VkWriteDescriptorSet, 2> setWrites = {};
+	setWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[0].dstSet = descriptorSets[currentFrame];					// descriptors to update
+	setWrites[0].dstBinding = 0;										// binding to update (match with binding on layout/shader)
+	setWrites[0].dstArrayElement = 0;									// index in array to update
+	setWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;	// type of descriptor
+	setWrites[0].descriptorCount = 1;									// amount to update
+	setWrites[0].pBufferInfo = &vpBufferInfo;							// information about buffer data to bind
+
+	setWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[1].dstSet = descriptorSets[currentFrame];
+	setWrites[1].dstBinding = 1;
+	setWrites[1].dstArrayElement = 0;
+	setWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	setWrites[1].descriptorCount = 1;
+	setWrites[1].pBufferInfo = &mBufferInfo;
+
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+
+	// OBJECT DATA DESCRIPTOR SET
+	// only bound in storage buffer mode
+	if (objectDataMode != OBJECT_DATA_STORAGE_BUFFER)
+	{
+		objectDescriptorSets[currentFrame] = VK_NULL_HANDLE;
+		return;
+	}
+
+	objectDescriptorSets[currentFrame] = frameDescriptorAllocators[currentFrame].allocate(objectSetLayout);
+
+	VkDescriptorBufferInfo transformBufferInfo = {};
+	transformBufferInfo.buffer = transformBuffer[currentFrame];
+	transformBufferInfo.offset = 0;
+	transformBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet objectSetWrite = {};
+	objectSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	objectSetWrite.dstSet = objectDescriptorSets[currentFrame];
+	objectSetWrite.dstBinding = 0;
+	objectSetWrite.dstArrayElement = 0;
+	objectSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectSetWrite.descriptorCount = 1;
+	objectSetWrite.pBufferInfo = &transformBufferInfo;
+
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &objectSetWrite, 0, nullptr);
+}
+
+void VulkanRenderer::updateUniformBuffers()
+{
+	// this frame's buffer already holds the current camera (the usual case, nothing to do)
+	if (vpUniformGenerations[currentFrame] == viewProjectionGeneration)
+	{
+		return;
+	}
+
+	// copy vp data straight into the mapped buffer
+	*mappedViewProjections[currentFrame] = uboViewProjection;
+
+	// the buffer is its own allocation, so the whole range also satisfies nonCoherentAtomSize alignment
+	if (!vpUniformMemoryCoherent)
+	{
+		VkMappedMemoryRange flushRange = {};
+		flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		flushRange.memory = vpUniformBufferMemory[currentFrame];
+		flushRange.offset = 0;
+		flushRange.size = VK_WHOLE_SIZE;
+		vkFlushMappedMemoryRanges(mainDevice.logicalDevice, 1, &flushRange);
 	}
+
+	vpUniformGenerations[currentFrame] = viewProjectionGeneration;
 }
 
-void VulkanRenderer::createDescriptorPool()
+void VulkanRenderer::updateTransformBuffer()
 {
-	// CREATE UNIFORM DESCRIPTOR POOL
-
-	// type of descriptors + how many DESCRIPTORS, not Descriptor Sets (combined makes the pool size)
-	// ViewProjection Pool
-	VkDescriptorPoolSize vpPoolSize = {};
-	vpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	vpPoolSize.descriptorCount = static_cast<uint32_t>(vpUniformBuffer.size());
+	// caller wrote the mapped array directly, take it over as the current state,
+	// so a later frame written through updateModel() doesn't copy stale matrices over it
+	if (modelsMapped)
+	{
+		memcpy(modelTransforms.data(), mappedTransforms[currentFrame], sizeof(glm::mat4) * modelTransforms.size());
+		return;
+	}
 
-	// Model Pool (DYNAMIC)
-	/*VkDescriptorPoolSize mPoolSize = {};
-	mPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	mPoolSize.descriptorCount = static_cast<uint32_t>(mDynamicUniformBuffer.size());*/
+	// one contiguous copy instead of a write per object
+	memcpy(mappedTransforms[currentFrame], modelTransforms.data(), sizeof(glm::mat4) * modelTransforms.size());
+}
 
-	// List of pool sizes
-	std::vector<VkDescriptorPoolSize> descriptorPoolSizes = { vpPoolSize/*, mPoolSize*/};
+void VulkanRenderer::recordCommands()
+{
+	// draws run inside the render pass begun by recordRenderPass(), the framebuffer is left open
+	// so they can be recorded before the swapchain image is known
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = VK_NULL_HANDLE;
 
-	// data to create descriptor pool
-	VkDescriptorPoolCreateInfo poolCreateInfo = {};
-	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolCreateInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());								//maximum number of descriptor sets that can be created from pool
-	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());					// amount of poolsizes being passed
-	poolCreateInfo.pPoolSizes = descriptorPoolSizes.data();															// poolsizes to create pool with
+	// information about how to begin each command buffer
+	VkCommandBufferBeginInfo bufferBeginInfo = {};
+	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	bufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-	// create descriptor tool
-	VkResult result = vkCreateDescriptorPool(mainDevice.logicalDevice, &poolCreateInfo, nullptr, &descriptorPool);
+	// start recording commands to command buffer
+	VkResult result = vkBeginCommandBuffer(sceneCommandBuffers[currentFrame], &bufferBeginInfo);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("failed to create a descriptor pool");
+		throw std::runtime_error("Faild to start recording a command buffer");
 	}
 
-	// CREATE SAMPLER DESCRIPTOR POOL
-	//texture sampler pool
-	VkDescriptorPoolSize samplerPoolSize = {};
-	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerPoolSize.descriptorCount = MAX_OBJECTS;
+	// picks up the link time optimized default pipeline once the registry has relinked it
+	graphicsPipeline = pipelineRegistry.get(defaultPipelineKey);
 
-	VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
-	samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
-	samplerPoolCreateInfo.poolSizeCount = 1;
-	samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
+	// bind pipeline to be used in render pass
+	vkCmdBindPipeline(sceneCommandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	VkPipeline boundPipeline = graphicsPipeline;
 
-	result = vkCreateDescriptorPool(mainDevice.logicalDevice, &samplerPoolCreateInfo, nullptr, &samplerDescriptorPool);
-	if (result != VK_SUCCESS)
+	// viewport and scissor are dynamic in every pipeline of the registry, they stay set across pipeline binds
+	VkViewport viewport = {};
+	viewport.x = 0.0f;									// x start coordinate
+	viewport.y = 0.0f;									// y start coordinate
+	viewport.width = (float)swapChainExtent.width;		// width of viewport
+	viewport.height = (float)swapChainExtent.height;	// height of viewport
+	viewport.minDepth = 0.0f;							// min framebuffer depth
+	viewport.maxDepth = 1.0f;							// max framebuffer depth
+	vkCmdSetViewport(sceneCommandBuffers[currentFrame], 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };							// offset to use region from
+	scissor.extent = swapChainExtent;					// extent to describe region to use, starting at offset
+	vkCmdSetScissor(sceneCommandBuffers[currentFrame], 0, 1, &scissor);
+
+	// per object data of this frame stays bound for all draws (set 2 isn't disturbed by rebinding sets 0-1 below)
+	if (objectDataMode == OBJECT_DATA_STORAGE_BUFFER)
 	{
-		throw std::runtime_error("failed to create a descriptor pool");
+		vkCmdBindDescriptorSets(sceneCommandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &objectDescriptorSets[currentFrame], 0, nullptr);
 	}
-}
 
-void VulkanRenderer::createDescriptorSets()
-{
-	// resize descriptorSet list so one for every buffer
-	descriptorSets.resize(swapChainImages.size());
+	// dynamic uniform buffer mode: every model at its aligned stride in this frame's allocator, drawn with offsets into it
+	bool dynamicModels = objectDataMode == OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER;
+	FrameAllocation modelAllocation = {};
+	if (dynamicModels)
+	{
+		modelAllocation = frameAllocators[currentFrame].allocate(modelUniformAlignment * meshes.size(), FRAME_ALLOCATION_UNIFORM);
+	}
 
-	std::vector<VkDescriptorSetLayout> setLayouts(swapChainImages.size(), descriptorSetLayout);
+	// levels of detail (and dynamic model copies) first, spread over the job system
+	// (recording stays on this thread, it's all one command buffer)
+	meshLods.resize(meshes.size());
+	jobSystem.parallelFor(meshes.size(), LOD_SELECTION_BATCH_SIZE, [&](size_t begin, size_t end) {
+		for (size_t j = begin; j < end; j++)
+		{
+			meshLods[j] = selectLod(meshes.atIndex(static_cast<uint32_t>(j)), modelTransforms[j]);
 
-	// descriptor set allocation info
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = descriptorPool;																// pool to allocate descriptor set from
-	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());	// number of sets to allocate
-	setAllocInfo.pSetLayouts = setLayouts.data();																// layouts to use to allocate sets (1 : 1 relationship)
+			if (dynamicModels)
+			{
+				memcpy(static_cast<unsigned char*>(modelAllocation.data) + modelUniformAlignment * j, &modelTransforms[j], sizeof(Model));
+			}
+		}
+	});
 
-	// allocate descriptor sets (multiple)
-	VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, descriptorSets.data());
-	if (result != VK_SUCCESS)
+	// straight over the dense array, no handle lookups per draw
+	Mesh* meshData = meshes.data();
+	for (size_t j = 0; j < meshes.size(); j++)
 	{
-		throw std::runtime_error("faild to allocate descriptor sets");
-	}
+		// mesh's own pipeline once it's compiled, until then the default one or nothing
+		VkPipeline meshPipeline = graphicsPipeline;
+		if (meshPipelines[j].key != 0)
+		{
+			VkPipeline readyPipeline = pipelineRegistry.get(meshPipelines[j].key);
+			if (readyPipeline != VK_NULL_HANDLE)
+			{
+				meshPipeline = readyPipeline;
+			}
+			else
+			{
+				// keep drawing until the real pipeline shows up (a failed compile stays on the fallback, nothing to wait for)
+				redrawNeeded |= pipelineRegistry.isPending(meshPipelines[j].key);
+				if (meshPipelines[j].fallback == PIPELINE_FALLBACK_SKIP)
+				{
+					continue;
+				}
+			}
+		}
 
-	// update all of descriptor set buffer bindings
-	for (size_t i = 0; i < swapChainImages.size(); i++)
-	{
-		// VIEW PROJECTION DESCRIPTOR
-		// buffer info and data offset info
-		VkDescriptorBufferInfo vpBufferInfo = {};
-		vpBufferInfo.buffer = vpUniformBuffer[i];					// buffer to get data from
-		vpBufferInfo.offset = 0;												// poition of start of data
-		vpBufferInfo.range = sizeof(UboViewProjection);						// size of data
+		// only rebind when the pipeline changes (descriptor sets stay bound, all pipelines share the layout)
+		if (meshPipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(sceneCommandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+			boundPipeline = meshPipeline;
+		}
 
-		// data about connection between binding and buffer
-		// (how descriptorSets[i] connects to uniformBuffer[i])
-		VkWriteDescriptorSet vpSetWrite = {};
-		vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		vpSetWrite.dstSet = descriptorSets[i];																// descriptors to update
-		vpSetWrite.dstBinding = 0;																				// binding to update (match with binding on layout/shader)
-		vpSetWrite.dstArrayElement = 0;																		// index in array to update
-		vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;		// type of descriptor
-		vpSetWrite.descriptorCount = 1;																		// amount to update
-		vpSetWrite.pBufferInfo = &vpBufferInfo;															// information about buffer data to bind
+		VkBuffer vertexBuffers[] = { meshData[j].getVertexBuffer() };								// buffers to bind
+		VkDeviceSize offsets[] = { 0 };																			// offsets into buffers being bound
+		vkCmdBindVertexBuffers(sceneCommandBuffers[currentFrame], 0, 1, vertexBuffers, offsets);		// command to bind vertex buffer before drawing with them
 
-		// MODEL DESCRIPTOR
-		// model buffer binding info
-		/*VkDescriptorBufferInfo mBufferInfo = {};
-		mBufferInfo.buffer = mDynamicUniformBuffer[i];
-		mBufferInfo.offset = 0;
-		mBufferInfo.range = modelUniformAlignment;
+		// bind mesh index buffer, with 0 offset and using the uint32 type (all LODs live in the same buffer)
+		vkCmdBindIndexBuffer(sceneCommandBuffers[currentFrame], meshData[j].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-		VkWriteDescriptorSet mSetWrite = {};
-		mSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		mSetWrite.dstSet = descriptorSets[i];
-		mSetWrite.dstBinding = 1;
-		mSetWrite.dstArrayElement = 0;
-		mSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		mSetWrite.descriptorCount = 1;
-		mSetWrite.pBufferInfo = &mBufferInfo;*/
+		// model matrix of this mesh for the current frame
+		const glm::mat4& model = modelTransforms[j];
 
-		// list of descriptor set writes
-		std::vector< VkWriteDescriptorSet> setWrites = { vpSetWrite/*, mSetWrite*/};
+		// picked above from how big its error would be on screen
+		const MeshLod& lod = meshData[j].getLod(meshLods[j]);
 
-		// update the descriptor sets with new buffer/binding info
-		// implementation of VkWriteDescriptorSet
-		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
-	}
-}
+		// push constants to given shader stage directly (no buffer)
+		// push constants only handle small size of data in CPU, so it is technically slower, but still faster than allocating memories
+		// if data is big size or static (NOT changed), use an allocated memory and keep it in GPU instead
+		// in storage buffer mode the shader reads the matrix itself, indexed by firstInstance below
+		if (objectDataMode == OBJECT_DATA_PUSH_CONSTANTS)
+		{
+			vkCmdPushConstants(
+				sceneCommandBuffers[currentFrame],
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT,	// stage to push constants to
+				0,														// offset of push constants to update
+				sizeof(Model),									// size of data being pushed
+				&model);										// actual data being pushed ( can be array) (model matrices live in the renderer's per frame array)
+		}
 
-void VulkanRenderer::updateUniformBuffers(uint32_t imageIndex)
-{
-	// copy vp data
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex], 0, sizeof(UboViewProjection), 0, &data);
-	memcpy(data, &uboViewProjection, sizeof(UboViewProjection));
-	vkUnmapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex]);
+		std::array<VkDescriptorSet, 2> descriptorSetGroup = { descriptorSets[currentFrame], textures.get(meshData[j].getTexId())->descriptorSet };
 
-	// copy model data
-	// not being used, this part is only for dynamic uniform buffer
-	/*for (size_t i = 0; i < meshList.size(); i++)
-	{
-		//  modelTransferSpace is allocated in allocateDynamicBufferTransferSpace()
-		//  using raw index won't get the correct address in C, so use i * modelUniformAlignment (which is the size of each block)
-		Model* thisModel = (Model*)((uint64_t)modelTransferSpace + (i * modelUniformAlignment));
-		//  set the model data to the value of the pointer points
-		*thisModel = meshList[i].getModel();
+		// dynamic offset amount
+		// set 0 has the dynamic model binding in every mode, so it always takes an offset (only read in dynamic uniform buffer mode)
+		uint32_t dynamicOffset = dynamicModels ? static_cast<uint32_t>(modelAllocation.offset + modelUniformAlignment * j) : 0;
+
+		// bind descriptor sets
+		vkCmdBindDescriptorSets(sceneCommandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 1, &dynamicOffset);
+
+		// execute pipeline
+		// firstInstance carries the mesh's dense index to gl_InstanceIndex
+		vkCmdDrawIndexed(sceneCommandBuffers[currentFrame], lod.indexCount, 1, lod.firstIndex, 0, static_cast<uint32_t>(j));
 	}
 
-	// map the list of model data
-	vkMapMemory(mainDevice.logicalDevice, mDynamicUniformBufferMemory[imageIndex], 0, modelUniformAlignment * meshList.size(), 0, &data);
-	memcpy(data, modelTransferSpace, modelUniformAlignment * meshList.size());
-	vkUnmapMemory(mainDevice.logicalDevice, mDynamicUniformBufferMemory[imageIndex]);
-	*/
+	// stop recording to command buffer
+	result = vkEndCommandBuffer(sceneCommandBuffers[currentFrame]);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Faild to stop recording a command buffer");
+	}
 }
 
-void VulkanRenderer::recordCommands(uint32_t currentImage)
+void VulkanRenderer::recordRenderPass(uint32_t imageIndex)
 {
 	// information about how to begin each command buffer
 	VkCommandBufferBeginInfo bufferBeginInfo = {};
 	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	// no longer need this flag after the fence has been set
-	// bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;	// whether a buffer can be resubmited when it has already been submitted and is awating execution
+	bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	// information about how to begin a render pass (only needed for graphival applications)
 	VkRenderPassBeginInfo renderPassBeginInfo = {};
@@ -1109,7 +1811,7 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
 	renderPassBeginInfo.renderPass = renderPass;							// render pass to begin
 	renderPassBeginInfo.renderArea.offset = { 0, 0 };						// start point of render pass in pixels
 	renderPassBeginInfo.renderArea.extent = swapChainExtent;				// size of region to run render pass on (starting at offset)
-	
+
 	std::array<VkClearValue, 2> clearValues = {};
 	clearValues[0].color = { 0.6f, 0.65f, 0.4f, 1.0f };
 	clearValues[1].depthStencil.depth = 1.0f;
@@ -1117,59 +1819,24 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
 	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassBeginInfo.pClearValues = clearValues.data();							// list of clear values
 
-	renderPassBeginInfo.framebuffer = swapChainFramebuffers[currentImage];
+	renderPassBeginInfo.framebuffer = swapChainFramebuffers[imageIndex];
 
-	// start recording commands to command buffer
-	VkResult result = vkBeginCommandBuffer(commandBuffers[currentImage], &bufferBeginInfo);
+	VkResult result = vkBeginCommandBuffer(commandBuffers[currentFrame], &bufferBeginInfo);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Faild to start recording a command buffer");
 	}
 
 	// vkcmd... means a command that could be recorded (not executed)
-	// begin render pass
-	vkCmdBeginRenderPass(commandBuffers[currentImage], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-	// bind pipeline to be used in render pass
-	vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-	for (size_t j = 0; j < meshList.size(); j++)
-	{
-		VkBuffer vertexBuffers[] = { meshList[j].getVertexBuffer() };								// buffers to bind
-		VkDeviceSize offsets[] = { 0 };																			// offsets into buffers being bound
-		vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets);		// command to bind vertex buffer before drawing with them
-
-		// bind mesh index buffer, with 0 offset and using the uint32 type
-		vkCmdBindIndexBuffer(commandBuffers[currentImage], meshList[j].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-
-		// dynamic offset amount
-		//uint32_t dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * j;
-
-		// push constants to given shader stage directly (no buffer)
-		// push constants only handle small size of data in CPU, so it is technically slower, but still faster than allocating memories
-		// if data is big size or static (NOT changed), use an allocated memory and keep it in GPU instead
-		vkCmdPushConstants(
-			commandBuffers[currentImage],
-			pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,	// stage to push constants to
-			0,														// offset of push constants to update
-			sizeof(Model),									// size of data being pushed
-			meshList[j].getModelRef());				// actual data being pushed ( can be array) ( a void pointer required but "Model model" is private, so get the reference straightly in Mesh.h)
-
-		std::array<VkDescriptorSet, 2> descriptorSetGroup = { descriptorSets[currentImage], samplerDescriptorSets[meshList[j].getTexId()]};
-
-		// bind descriptor sets
-		vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
-
-		// execute pipeline
-		vkCmdDrawIndexed(commandBuffers[currentImage], meshList[j].getIndexCount(), 1, 0, 0, 0);
-	}
+	// begin render pass, its contents come from the frame's secondary command buffer
+	vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	vkCmdExecuteCommands(commandBuffers[currentFrame], 1, &sceneCommandBuffers[currentFrame]);
 
 	// end render pass
-	vkCmdEndRenderPass(commandBuffers[currentImage]);
+	vkCmdEndRenderPass(commandBuffers[currentFrame]);
 
 	// stop recording to command buffer
-	result = vkEndCommandBuffer(commandBuffers[currentImage]);
+	result = vkEndCommandBuffer(commandBuffers[currentFrame]);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Faild to stop recording a command buffer");
@@ -1202,49 +1869,235 @@ void VulkanRenderer::getPhysicalDevice()
 		}
 	}
 
+	// memory types, heaps and budgets for every buffer and image created on it
+	deviceMemoryInfo = getDeviceMemoryInfo(mainDevice.physicalDevice);
+
 	// get properties of our new device
 	VkPhysicalDeviceProperties deviceProperties;
 	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
 
-	//minUniformBufferOffset = deviceProperties.limits.minUniformBufferOffsetAlignment;
-}
-/*
-void VulkanRenderer::allocateDynamicBufferTransferSpace()
-{
-	// e.g. 32bits minUniformBufferOffset
-	// 00100000 - 1 = 00011111
-	// ~(00011111) = 11100000 
-	// 
-	// 66 bits model size
-	// 01000010 + 00100000 = 01100010 
-	// 01100010 - 1 = 01100001
-	//
-	// 01100001 use 11100000 as bit mask:
-	// 01100001
-	// &
-	// 11100000
-	// 01100000 which means modelUniformAlignment = 96 bits
-	//     ^
-	//   this "1" remains
-	// 
-	// 64 bits model size
-	// 01000000 + 00100000 = 01100000 
-	// 01100000 - 1 = 01011111
-	// 01011111 use 11100000 as bit mask:
-	// 01011111
-	// &
-	// 11100000
-	// 01000000 which means modelUniformAlignment = 64 bits
-	//    ^
-	//   this "1" does not remain
-
-	// calculate alignment of model data
-	modelUniformAlignment = (sizeof(Model) + minUniformBufferOffset - 1) & ~(minUniformBufferOffset - 1);
-
-	// create space in memory to hold dynamic buffer that is aligned to our required alignment and holds MAX_OBJECTS
-	modelTransferSpace = (Model*)_aligned_malloc(modelUniformAlignment * MAX_OBJECTS, modelUniformAlignment);
-}
-*/
+	// dynamic uniform buffer offsets must be multiples of minUniformBufferOffsetAlignment (a power of two)
+	// so round the size of a model up to the next multiple, e.g. 64 bytes with an alignment of 256 -> 256
+	VkDeviceSize minUniformBufferOffset = deviceProperties.limits.minUniformBufferOffsetAlignment;
+	if (minUniformBufferOffset > 0)
+	{
+		modelUniformAlignment = (sizeof(Model) + minUniformBufferOffset - 1) & ~(minUniformBufferOffset - 1);
+	}
+}
+
+VulkanRenderer::SharedMeshBuffers& VulkanRenderer::addMeshBuffers(MeshBuffers&& buffers)
+{
+	SharedMeshBuffers& shared = meshBuffers[buffers.vertexBuffer.get()];
+	shared.buffers = std::move(buffers);
+	return shared;
+}
+
+MeshHandle VulkanRenderer::addMesh(SharedMeshBuffers& shared, TextureHandle texture, const glm::mat4& model)
+{
+	// may rebuild the per frame arrays, which belong to the render thread
+	if (renderThread.joinable())
+	{
+		throw std::runtime_error("addMesh() can't be used in render thread mode");
+	}
+
+	// a mesh keeps its texture alive (meshCount), so recordCommands() can use it without checking the handle again
+	Texture* meshTexture = textures.get(texture);
+	if (!meshTexture)
+	{
+		throw std::runtime_error("addMesh() with a texture that doesn't exist");
+	}
+
+	// constructed in place, it's only a reference to the shared buffers and the texture
+	MeshHandle handle = meshes.emplace(shared.buffers, texture);
+	shared.meshCount++;
+
+	meshTexture->meshCount++;
+	modelTransforms.push_back(model);
+	meshPipelines.push_back({ 0, PIPELINE_FALLBACK_DEFAULT });		// key 0 = default pipeline
+	redrawNeeded = true;
+
+	// grow the per frame arrays (only happens while loading, so waiting for the device is fine)
+	if (modelTransforms.size() > transformCapacity)
+	{
+		uint32_t newCapacity = std::max(static_cast<uint32_t>(modelTransforms.size()), transformCapacity * 2);
+
+		vkDeviceWaitIdle(mainDevice.logicalDevice);
+		destroyTransformBuffers();
+		createTransformBuffers(newCapacity);
+
+		// model matrices in dynamic uniform buffer mode have to fit as well
+		// (the frame's descriptor sets are written when it's drawn, they pick up the new buffers by themselves)
+		destroyFrameAllocators();
+		createFrameAllocators();
+	}
+
+	return handle;
+}
+
+void VulkanRenderer::destroyFrameResources()
+{
+	vkFreeCommandBuffers(mainDevice.logicalDevice, graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	vkFreeCommandBuffers(mainDevice.logicalDevice, graphicsCommandPool, static_cast<uint32_t>(sceneCommandBuffers.size()), sceneCommandBuffers.data());
+	commandBuffers.clear();
+	sceneCommandBuffers.clear();
+
+	// sets go with their pools
+	for (DescriptorAllocator& frameDescriptorAllocator : frameDescriptorAllocators)
+	{
+		frameDescriptorAllocator.destroy();
+	}
+	frameDescriptorAllocators.clear();
+	descriptorSets.clear();
+	objectDescriptorSets.clear();
+
+	for (size_t i = 0; i < vpUniformBuffer.size(); i++)
+	{
+		vkUnmapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[i]);
+		vkDestroyBuffer(mainDevice.logicalDevice, vpUniformBuffer[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, vpUniformBufferMemory[i], nullptr);
+	}
+	vpUniformBuffer.clear();
+	vpUniformBufferMemory.clear();
+	mappedViewProjections.clear();
+	vpUniformGenerations.clear();
+
+	destroyFrameAllocators();
+
+	destroyTransformBuffers();
+
+	for (size_t i = 0; i < imageAvailable.size(); i++)
+	{
+		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
+	}
+	imageAvailable.clear();
+	frameTimelineValues.clear();
+	frameTimings.clear();
+}
+
+void VulkanRenderer::recreateSwapChain()
+{
+	// images may still be drawn to or waiting to be presented
+	vkDeviceWaitIdle(mainDevice.logicalDevice);
+
+	// the window keeps its size, so render pass, depth buffer and pipelines stay valid
+	destroySwapChain();
+	createSwapChain();
+	createFramebuffers();
+}
+
+void VulkanRenderer::destroySwapChain()
+{
+	for (auto framebuffer : swapChainFramebuffers) {
+		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
+	}
+	swapChainFramebuffers.clear();
+
+	for (auto image : swapChainImages)
+	{
+		vkDestroySemaphore(mainDevice.logicalDevice, image.renderFinished, nullptr);
+		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
+	}
+	swapChainImages.clear();
+
+	vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, nullptr);
+	swapchain = VK_NULL_HANDLE;
+}
+
+void VulkanRenderer::destroyTransformBuffers()
+{
+	for (size_t i = 0; i < transformBuffer.size(); i++)
+	{
+		vkUnmapMemory(mainDevice.logicalDevice, transformBufferMemory[i]);
+		vkDestroyBuffer(mainDevice.logicalDevice, transformBuffer[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, transformBufferMemory[i], nullptr);
+	}
+	transformBuffer.clear();
+	transformBufferMemory.clear();
+	mappedTransforms.clear();
+	transformCapacity = 0;
+}
+
+void VulkanRenderer::destroyFrameAllocators()
+{
+	for (FrameAllocator& frameAllocator : frameAllocators)
+	{
+		frameAllocator.destroy();
+	}
+	frameAllocators.clear();
+}
+
+void VulkanRenderer::destroyTexture(TextureHandle texture)
+{
+	Texture* removed = textures.get(texture);
+	if (!removed)
+	{
+		return;
+	}
+
+	// frames submitted so far may still sample it, the set goes back to the allocator for the next texture after them
+	uint64_t lastUseValue = graphicsTimeline.getLastValue();
+	deletionQueue.freeDescriptorSet(textureDescriptorAllocator, removed->descriptorSet, samplerSetLayout, lastUseValue);
+	deletionQueue.destroyImageView(removed->imageView.release(), lastUseValue);
+	deletionQueue.destroyImage(removed->image.release(), lastUseValue);
+	deletionQueue.freeMemory(removed->memory.release(), lastUseValue);
+
+	textures.remove(texture);
+}
+
+void VulkanRenderer::measureFrameLatency(uint64_t completedValue)
+{
+	// finish time is when this notices, so frames found by polling are counted up to one draw() late
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < frameTimings.size(); i++)
+	{
+		if (frameTimings[i].pending && frameTimelineValues[i] <= completedValue)
+		{
+			std::lock_guard<std::mutex> lock(latencyMutex);
+			latencySum += std::chrono::duration<double, std::milli>(now - frameTimings[i].begin).count();
+			latencyCount++;
+			frameTimings[i].pending = false;
+		}
+	}
+}
+
+int VulkanRenderer::selectLod(Mesh& mesh, const glm::mat4& model)
+{
+	if (mesh.getLodCount() == 1)
+	{
+		return 0;
+	}
+
+	// errors are in object space, so scale them by the largest axis scale of the model matrix
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	// distance from camera to the nearest point of the bounding sphere
+	glm::vec4 viewCenter = uboViewProjection.view * model * glm::vec4(mesh.getBoundsCenter(), 1.0f);
+	float distance = glm::length(glm::vec3(viewCenter)) - mesh.getBoundsRadius() * scale;
+
+	// camera inside bounding sphere, always full detail
+	if (distance <= 0.0f)
+	{
+		return 0;
+	}
+
+	// projection[1][1] = cot(fov / 2) (negated for vulkan's flipped Y), so this is how many pixels one unit covers at that distance
+	float pixelsPerUnit = std::abs(uboViewProjection.projection[1][1]) * swapChainExtent.height * 0.5f / distance;
+
+	// coarsest LOD whose projected error is still below the threshold (errors grow along the chain)
+	int lod = 0;
+	for (int i = 1; i < mesh.getLodCount(); i++)
+	{
+		if (mesh.getLod(i).error * scale * pixelsPerUnit > lodErrorThreshold)
+		{
+			break;
+		}
+		lod = i;
+	}
+
+	return lod;
+}
+
 bool VulkanRenderer::checkInstanceExtensionSupport(std::vector<const char*>* checkExtensions)
 {
 	//need to get the number of extensions to create array of correct size to hold extensions
@@ -1315,6 +2168,46 @@ bool VulkanRenderer::checkDeviceExtensionSupport(VkPhysicalDevice device)
 	return true;
 }
 
+bool VulkanRenderer::checkGraphicsPipelineLibrarySupport(VkPhysicalDevice device)
+{
+	// feature query needs a 1.1 device
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return false;
+	}
+
+	// both the library extension and the graphics pipeline part of it
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+	bool hasPipelineLibrary = false;
+	bool hasGraphicsPipelineLibrary = false;
+	for (const auto& extension : extensions)
+	{
+		hasPipelineLibrary |= strcmp(extension.extensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0;
+		hasGraphicsPipelineLibrary |= strcmp(extension.extensionName, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0;
+	}
+	if (!hasPipelineLibrary || !hasGraphicsPipelineLibrary)
+	{
+		return false;
+	}
+
+	// extension may be exposed without the feature being usable
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures = {};
+	graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 deviceFeatures = {};
+	deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures.pNext = &graphicsPipelineLibraryFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+
+	return graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+}
+
 bool VulkanRenderer::checkDeviceSuitable(VkPhysicalDevice device)
 {
 	// information about the device itself (id, name, type, vender, etc)
@@ -1336,7 +2229,22 @@ bool VulkanRenderer::checkDeviceSuitable(VkPhysicalDevice device)
 		swapChainValid = !swapChainDetails.presentationModes.empty() && !swapChainDetails.formats.empty();
 	}
 
-	return indices.isValid() && extensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy;
+	// frame pacing runs on timeline semaphores (core in 1.2)
+	bool timelineSemaphoreSupported = false;
+	if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
+		timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+		VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.pNext = &timelineSemaphoreFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+		timelineSemaphoreSupported = timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+	}
+
+	return indices.isValid() && extensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy && timelineSemaphoreSupported;
 }
 
 QueueFamilyIndices VulkanRenderer::getQueueFamilies(VkPhysicalDevice device)
@@ -1436,18 +2344,49 @@ VkSurfaceFormatKHR VulkanRenderer::chooseBestSurfaceFormat(const std::vector<VkS
 
 VkPresentModeKHR VulkanRenderer::chooseBestPresentationMode(const std::vector<VkPresentModeKHR> presentationModes)
 {
-	for (const auto& presentationMode : presentationModes)
+	// vsync is all power saving needs (and FIFO is the only mode every device has)
+	if (presentPolicy == PRESENT_POLICY_POWER_SAVING)
 	{
-		if (presentationMode == VK_PRESENT_MODE_MAILBOX_KHR)
-		{
-			return presentationMode;
-		}
+		return VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+	// mailbox never tears and always shows the newest image
+	if (std::find(presentationModes.begin(), presentationModes.end(), VK_PRESENT_MODE_MAILBOX_KHR) != presentationModes.end())
+	{
+		return VK_PRESENT_MODE_MAILBOX_KHR;
+	}
+
+	// low latency would rather tear than wait for the next vblank
+	if (presentPolicy == PRESENT_POLICY_LOW_LATENCY
+		&& std::find(presentationModes.begin(), presentationModes.end(), VK_PRESENT_MODE_IMMEDIATE_KHR) != presentationModes.end())
+	{
+		return VK_PRESENT_MODE_IMMEDIATE_KHR;
 	}
 
 	// if can't find mailbox mode, use FIFO as backup
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+uint32_t VulkanRenderer::chooseSwapImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities)
+{
+	// how many images are in the swapchain? get 1 more than the minimum to allow triple buffering
+	// power saving keeps the minimum, fewer images queued = less work ahead of the display
+	uint32_t imageCount = surfaceCapabilities.minImageCount;
+	if (presentPolicy != PRESENT_POLICY_POWER_SAVING)
+	{
+		imageCount++;
+	}
+
+	// if imageCount higher than max, then clamp down to max
+	// if 0, then limitless
+	if (surfaceCapabilities.maxImageCount > 0 && surfaceCapabilities.maxImageCount < imageCount)
+	{
+		imageCount = surfaceCapabilities.maxImageCount;
+	}
+
+	return imageCount;
+}
+
 VkExtent2D VulkanRenderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities)
 {
 	// if current extent is at numeric limits, then extent can vary. Otherwise, it is the size of the window
@@ -1500,7 +2439,7 @@ VkFormat VulkanRenderer::chooseSupportedFormat(const std::vector<VkFormat>& form
 	throw std::runtime_error("failed to find a matching format!");
 }
 
-VkImage VulkanRenderer::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory)
+VkImage VulkanRenderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory)
 {
 	// CREATE IMAGE
 	// Image Creation Info
@@ -1510,8 +2449,8 @@ VkImage VulkanRenderer::createImage(uint32_t width, uint32_t height, VkFormat fo
 	imageCreateInfo.extent.width = width;												// width of image extent
 	imageCreateInfo.extent.height = height;												// height ofo image extent
 	imageCreateInfo.extent.depth = 1;														// depth of image (just 1, no 3D aspect)
-	imageCreateInfo.mipLevels = 1;															// number of mipmap levels
-	imageCreateInfo.arrayLayers = 1;														// number of levels in image array
+	imageCreateInfo.mipLevels = mipLevels;												// number of mipmap levels
+	imageCreateInfo.arrayLayers = arrayLayers;											// number of levels in image array
 	imageCreateInfo.format = format;														// format type of image
 	imageCreateInfo.tiling = tiling;															// how image data should be "tiled" (arraged for optimal reading)
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;		// layout of image data on creation
@@ -1535,7 +2474,7 @@ VkImage VulkanRenderer::createImage(uint32_t width, uint32_t height, VkFormat fo
 	VkMemoryAllocateInfo memoryAllocInfo = {};
 	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	memoryAllocInfo.allocationSize = memoryRequirements.size;
-	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(mainDevice.physicalDevice, memoryRequirements.memoryTypeBits, propFlags);
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(deviceMemoryInfo, memoryRequirements.memoryTypeBits, propFlags);
 	
 	result = vkAllocateMemory(mainDevice.logicalDevice, &memoryAllocInfo, nullptr, imageMemory);
 	if (result != VK_SUCCESS)
@@ -1579,110 +2518,62 @@ VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkIm
 	return imageView;
 }
 
-VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code)
+VkImage VulkanRenderer::createTextureImage(const unsigned char* pixels, int width, int height, UploadBatch& uploadBatch, VkDeviceMemory* imageMemory)
 {
-	// shader module creation information
-	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCreateInfo.codeSize = code.size();
-	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); //reinterpret_cast converts between pointers (of different types)
+	VkDeviceSize imageSize = VkDeviceSize(width) * height * 4;
 
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(mainDevice.logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to create a shader module");
-	}
+	// create image to hold final texture
+	VkImage texImage = createImage(width, height, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageMemory);
+
+	// layout transitions and copy are recorded into the batch, pixels are already in staging memory after this
+	uploadBatch.uploadImage(pixels, imageSize, texImage, width, height);
 
-	return shaderModule;
+	return texImage;
 }
 
-int VulkanRenderer::createTextureImage(std::string fileName)
+std::vector<TextureHandle> VulkanRenderer::createTextures(const std::vector<std::string>& fileNames)
 {
-	// load image file
-	int width, height;
-	VkDeviceSize imageSize;
-	stbi_uc* imageData = loadTextureFile(fileName, &width, &height, &imageSize);
-
-	// create staging buffer to hold loaded data, ready to copy to device
-	VkBuffer imageStagingBuffer;
-	VkDeviceMemory imageStagingBufferMemory;
-	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&imageStagingBuffer, &imageStagingBufferMemory);
-
-	// copy image data to staging buffer
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, imageStagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, imageData, static_cast<size_t>(imageSize));
-	vkUnmapMemory(mainDevice.logicalDevice, imageStagingBufferMemory);
+	// all of them in one submission with one wait on the graphics timeline (no vkQueueWaitIdle),
+	// the images share one barrier before and one after their copies
+	UploadBatch uploadBatch(deviceMemoryInfo, mainDevice.logicalDevice, graphicsTimeline, graphicsCommandPool);
 
-	// free original image data
-	stbi_image_free(imageData);
-
-	// create image to hold final texture
-	VkImage texImage;
-	VkDeviceMemory texImageMemory;
-	texImage = createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texImageMemory);
-
-	// copy data to image
-	// transition image to be DST for copy operation
-	transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool,
-		texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-	// copy image data
-	copyImageBuffer(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, imageStagingBuffer, texImage, width, height);
+	std::vector<TextureHandle> textureIds;
+	for (const std::string& fileName : fileNames)
+	{
+		// load image file
+		int width, height;
+		VkDeviceSize imageSize;
+		stbi_uc* imageData = loadTextureFile(fileName, &width, &height, &imageSize);
 
-	// transition image to be shader readable for shader usage
-	transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool,
-		texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		textureIds.push_back(createTexture(imageData, width, height, uploadBatch));
 
-	// add texture data to vector for reference
-	textureImages.push_back(texImage);
-	textureImageMemory.push_back(texImageMemory);
+		// free original image data (already copied to staging memory)
+		stbi_image_free(imageData);
+	}
 
-	// destroy staging buffers
-	vkDestroyBuffer(mainDevice.logicalDevice, imageStagingBuffer, nullptr);
-	vkFreeMemory(mainDevice.logicalDevice, imageStagingBufferMemory, nullptr);
+	uploadBatch.submit();
 
-	// return index of new texture image
-	return textureImages.size() - 1;
+	return textureIds;
 }
 
-int VulkanRenderer::createTexture(std::string fileName)
+TextureHandle VulkanRenderer::createTexture(const unsigned char* pixels, int width, int height, UploadBatch& uploadBatch)
 {
-	// create trxture image and get its  location in array
-	int textureImageLoc = createTextureImage(fileName);
-
-	// create image view and add to list
-	VkImageView imageView = createImageView(textureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-	textureImageViews.push_back(imageView);
+	Texture texture;
+	texture.device = mainDevice.logicalDevice;
+	*texture.image.put() = createTextureImage(pixels, width, height, uploadBatch, texture.memory.put());
 
-	// create texture descriptor
-	int descriptorLoc = createTextureDescriptor(imageView);
+	// view and descriptor can be made before the upload is submitted, they are only used once it has finished
+	*texture.imageView.put() = createImageView(texture.image.get(), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+	texture.descriptorSet = createTextureDescriptor(texture.imageView.get());
 
-	// return location of set with texture
-	return descriptorLoc;
+	return textures.add(std::move(texture));
 }
 
-int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
+VkDescriptorSet VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
 {
-	VkDescriptorSet descriptorSet;
-
-	// descriptor set allocation info
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = samplerDescriptorPool;
-	setAllocInfo.descriptorSetCount = 1;
-	setAllocInfo.pSetLayouts = &samplerSetLayout;
-
-	// allocate descriptor sets
-	VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, &descriptorSet);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate Texture Descriptor Sets");
-	}
+	// allocate descriptor set (allocator opens another pool when needed, so there's no texture limit)
+	VkDescriptorSet descriptorSet = textureDescriptorAllocator.allocate(samplerSetLayout);
 
 	//texture image info
 	VkDescriptorImageInfo imageInfo = {};
@@ -1703,11 +2594,7 @@ int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
 	// update new descriptor set
 	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &descriptorWrite, 0, nullptr);
 
-	// add descriptor set to list
-	samplerDescriptorSets.push_back(descriptorSet);
-
-	// return descriptor set location
-	return samplerDescriptorSets.size() - 1;
+	return descriptorSet;
 }
 
 stbi_uc* VulkanRenderer::loadTextureFile(std::string fileName, int* width, int* height, VkDeviceSize* imageSize)
@@ -1715,9 +2602,13 @@ stbi_uc* VulkanRenderer::loadTextureFile(std::string fileName, int* width, int*
 	// number of channels image uses
 	int channels;
 
-	// load pixel data for image
-	std::string filePath = "Textures/" + fileName;
-	stbi_uc* image = stbi_load(filePath.c_str(), width, height, &channels, STBI_rgb_alpha);
+	// decode straight from the mapped file (stbi_load would read it through stdio into its own buffers first)
+	MappedFile file;
+	stbi_uc* image = nullptr;
+	if (file.open("Textures/" + fileName) && file.size() <= INT_MAX)
+	{
+		image = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()), width, height, &channels, STBI_rgb_alpha);
+	}
 
 	if (!image)
 	{
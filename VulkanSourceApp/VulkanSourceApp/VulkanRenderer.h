@@ -10,12 +10,33 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <cmath>
 #include<array>
+#include <climits>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "stb_image.h"
 
+#include "DeletionQueue.h"
+#include "DescriptorAllocator.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
 #include "Mesh.h"
+#include "PipelineCache.h"
+#include "PipelineRegistry.h"
+#include "QueueTimeline.h"
+#include "SceneLoader.h"
+#include "SlotMap.h"
+#include "SpscQueue.h"
+#include "UploadBatch.h"
 #include "Utilities.h"
+#include "VulkanHandle.h"
 
 class VulkanRenderer
 {
@@ -24,9 +45,92 @@ public:
 
 	int init(GLFWwindow* newWindow);
 
-	void updateModel(int modelId, glm::mat4 newModel);
+	// stale handles (of removed meshes) are ignored by every function taking one
+	void updateModel(MeshHandle mesh, glm::mat4 newModel);
+	// set many model matrices in one call, models[i] goes to meshes[i] (a single queued command in render thread mode)
+	void updateModels(const MeshHandle* meshes, const glm::mat4* models, size_t count);
 
+	// direct access to this frame's model matrices in mapped memory, in dense order (getMeshHandle(i) is drawn with [i])
+	// waits until the GPU is done with the array's previous frame, then ALL matrices must be written before draw():
+	// the array is not filled from updateModel() in a frame where it was mapped, what was written there replaces those matrices
+	glm::mat4* mapModels();
+	uint32_t getModelCount();
+
+	// handle of the mesh at a dense index, removing a mesh moves the last one into its index
+	MeshHandle getMeshHandle(uint32_t index);
+
+	// load a .gltf/.glb/.obj file from Models/, returns one handle per placed instance (for updateModel)
+	// instances of the same scene mesh share its buffers, can't be used in render thread mode
+	std::vector<MeshHandle> loadScene(std::string fileName, MeshCreateFlags createFlags = 0);
+
+	// draw an already loaded mesh once more with its own model matrix, returns the new mesh's handle
+	// the copy shares the mesh's buffers and texture, can't be used in render thread mode
+	MeshHandle addMeshInstance(MeshHandle mesh, const glm::mat4& model);
+
+	// stop drawing a mesh, its buffers (and texture) are destroyed once no other mesh uses them
+	// and the frames already submitted are done with them (never waits), can't be used in render thread mode
+	void removeMesh(MeshHandle mesh);
+
+	// switch how per object data reaches the shader, rebuilds the pipeline if already initialized, can't be used in render thread mode
+	void setObjectDataMode(ObjectDataMode mode);
+
+	// state of the pipeline meshes are drawn with by default, a starting point for variants
+	PipelineState getDefaultPipelineState();
+
+	// queue a pipeline variant for background compilation (returns at once, the same state always gives the same key)
+	PipelineKey requestPipeline(const PipelineState& state);
+
+	// draw a mesh with a requested pipeline, fallback decides what happens while it isn't compiled yet
+	void setMeshPipeline(MeshHandle mesh, PipelineKey pipelineKey, PipelineFallback fallback = PIPELINE_FALLBACK_DEFAULT);
+
+	// largest screen space error (in pixels) a mesh LOD may have to be picked for drawing
+	void setLodErrorThreshold(float pixels);
+
+	// camera view matrix
+	void setView(const glm::mat4& newView);
+
+	// frames the CPU may record ahead of the GPU: 1 = lowest latency, more = more CPU/GPU overlap (at least 1)
+	// rebuilds every per frame resource (waiting for the device) if already initialized, can't be used in render thread mode
+	void setFramesInFlight(uint32_t count);
+
+	// pick present mode, swapchain image count and frames in flight together, recreates the swapchain if already initialized
+	// (setFramesInFlight() afterwards still overrides the frame count), does nothing if the policy doesn't change
+	// throws std::runtime_error while the render thread runs
+	void setPresentPolicy(PresentPolicy policy);
+
+	// mark the start of a frame, call right after input was sampled (before updating models and draw())
+	// frames drawn without it count from the start of draw()
+	void beginFrame();
+
+	// average time in ms from beginFrame() until the GPU finished rendering the frame, over the frames finished since the last call
+	// (the present itself isn't observable without VK_KHR_present_wait, so this is the latency up to the image being ready for it)
+	// returns 0 if no frame finished in between
+	double getFrameLatency();
+
+	// job system counters (jobs run, steals, worker idle time) since the last call
+	JobSystemStats getJobStats();
+
+	// poll window events, or while there is nothing to draw, block until one arrives (or idleTimeout seconds passed)
+	void pollEvents(double idleTimeout = IDLE_EVENT_TIMEOUT);
+
+	// draw the next frame if anything changed since the last one (models, camera, meshes, pipelines or settings)
+	// otherwise skip it, the last presented image is still current
 	void draw();
+
+	// render thread mode: frames are drawn on a thread of their own while the calling thread simulates the next one
+	// updateModel(s), setView, setMeshPipeline, setLodErrorThreshold, requestRedraw, beginFrame and draw
+	// are queued (lock-free) and applied by the render thread in order, draw() only waits if the render thread is
+	// more than one frame behind. Those must all be called from the same thread, everything else (loading, mapModels,
+	// settings that rebuild resources) needs the render thread stopped and throws std::runtime_error otherwise
+	void startRenderThread();
+	void stopRenderThread();		// draws everything still queued first
+
+	// draw the next frame even if nothing changed (e.g. after changing memory from mapModels() outside a frame)
+	void requestRedraw();
+
+	// last draw() was skipped because nothing changed
+	bool isIdle();
+
 	void cleanup(); // whenever the vkCreate*() is called, there also needs a destroy function to be called in cleanup()
 
 	~VulkanRenderer();
@@ -35,9 +139,90 @@ private:
 	GLFWwindow* window;
 
 	int currentFrame = 0;
+	uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	PresentPolicy presentPolicy = PRESENT_POLICY_THROUGHPUT;
+
+	// latency measurement
+	struct FrameTiming {
+		std::chrono::steady_clock::time_point begin;		// beginFrame() of the frame last submitted in this slot
+		bool pending;										// its latency hasn't been measured yet
+	};
+	std::vector<FrameTiming> frameTimings;				// one per frame in flight
+	std::chrono::steady_clock::time_point nextFrameBegin;
+	bool frameBegun = false;
+	double latencySum = 0.0;
+	uint32_t latencyCount = 0;
+	std::mutex latencyMutex;
+
+	float lodErrorThreshold = 1.0f;
+	std::vector<int> meshLods;			// LOD of every mesh in the frame being recorded
+
+	// CPU work of a frame (and scene loading) fanned out over the cores
+	JobSystem jobSystem;
+
+	// idle skip
+	bool redrawNeeded = true;			// something changed since the last drawn frame
+	std::atomic<bool> idle{ false };	// last draw() was skipped (read by the caller's thread in render thread mode)
+
+	// render thread
+	enum RenderCommandType {
+		RENDER_COMMAND_UPDATE_MODEL,
+		RENDER_COMMAND_UPDATE_MODELS,
+		RENDER_COMMAND_SET_VIEW,
+		RENDER_COMMAND_SET_MESH_PIPELINE,
+		RENDER_COMMAND_SET_LOD_ERROR_THRESHOLD,
+		RENDER_COMMAND_REQUEST_REDRAW,
+		RENDER_COMMAND_BEGIN_FRAME,
+		RENDER_COMMAND_DRAW,
+	};
+	struct ModelUpdate {
+		MeshHandle mesh;
+		glm::mat4 model;
+	};
+	struct RenderCommand {
+		RenderCommandType type;
+		MeshHandle mesh;
+		uint32_t value;								// flags / fallback
+		float scalar;
+		PipelineKey key;
+		glm::mat4 matrix;
+		std::chrono::steady_clock::time_point time;
+		std::vector<ModelUpdate>* modelUpdates;		// updateModels() batch, owned by the command (freed when it's applied)
+	};
+	SpscQueue<RenderCommand> renderCommands{ RENDER_COMMAND_QUEUE_SIZE };
+	std::thread renderThread;
+	std::mutex renderThreadMutex;						// only for sleeping and frame counting, commands don't take it
+	std::condition_variable renderThreadCondition;		// a frame was queued or stopping
+	std::condition_variable frameDrawnCondition;		// render thread finished a frame
+	uint32_t queuedFrames = 0;
+	bool renderThreadStopping = false;
+	std::exception_ptr renderThreadError;				// rethrown by the next draw()
 
 	//Scene Objects
-	std::vector<Mesh> meshList;
+	// meshes are packed densely for recording, the arrays below are kept in the same order (removal moves the last one into the hole)
+	SlotMap<Mesh> meshes;
+
+	// buffers (with LODs and bounds) of the meshes, keyed by vertex buffer: shared by instances and destroyed with the last mesh drawn from them
+	// meshes point into them, the map's nodes never move
+	struct SharedMeshBuffers {
+		MeshBuffers buffers;
+		uint32_t meshCount = 0;
+	};
+	std::unordered_map<VkBuffer, SharedMeshBuffers> meshBuffers;
+
+	std::vector<glm::mat4> modelTransforms;		// model matrix of each mesh, written by updateModel()
+	bool modelsMapped = false;								// mapModels() was called this frame, so modelTransforms is copied back from the mapping
+
+	// pipeline of each mesh
+	struct MeshPipeline {
+		PipelineKey key;						// 0 = default pipeline
+		PipelineFallback fallback;
+	};
+	std::vector<MeshPipeline> meshPipelines;
+
+	ObjectDataMode objectDataMode = OBJECT_DATA_PUSH_CONSTANTS;
+	VkDeviceSize modelUniformAlignment = sizeof(Model);		// stride of model matrices in dynamic uniform buffer mode (minUniformBufferOffsetAlignment)
+	bool initialized = false;
 
 	//Scene Settings
 	struct UboViewProjection {
@@ -52,14 +237,17 @@ private:
 		VkPhysicalDevice physicalDevice;
 		VkDevice logicalDevice;
 	} mainDevice;
+	DeviceMemoryInfo deviceMemoryInfo;		// queried once in getPhysicalDevice(), counts what createBuffer() allocates (render thread stopped)
 	VkQueue graphicsQueue;
 	VkQueue presentationQueue;
 	VkSurfaceKHR surface;
+	bool graphicsPipelineLibrarySupported = false;		// VK_EXT_graphics_pipeline_library enabled on the device
 	VkSwapchainKHR swapchain;
 
 	std::vector<SwapchainImage> swapChainImages;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
-	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkCommandBuffer> commandBuffers;			// primary of each frame in flight, only begins the render pass on the acquired image
+	std::vector<VkCommandBuffer> sceneCommandBuffers;		// secondary of each frame in flight, all draws (recorded before the image is acquired)
 
 	VkImage depthBufferImage;
 	VkDeviceMemory depthBufferImageMemory;
@@ -70,30 +258,58 @@ private:
 	// - Descriptor
 	VkDescriptorSetLayout descriptorSetLayout;		// how descripor be laid out on a shader
 	VkDescriptorSetLayout samplerSetLayout;
+	VkDescriptorSetLayout objectSetLayout;			// per object storage buffer (model matrices)
 	VkPushConstantRange pushConstantRange;
 
-	VkDescriptorPool descriptorPool;						// where the descriptor sets will be allocated
-	VkDescriptorPool samplerDescriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;	// for view projection matrices of swapchain images
-	std::vector<VkDescriptorSet> samplerDescriptorSets; // for textures
+	DescriptorAllocator textureDescriptorAllocator;	// texture sets, grows with the number of textures
+	std::vector<DescriptorAllocator> frameDescriptorAllocators;	// sets that only live for one frame, reset when the frame's timeline value is waited on
+	std::vector<FrameAllocator> frameAllocators;				// shader data that only lives for one frame, reset together with the sets
+	std::vector<VkDescriptorSet> descriptorSets;	// for view projection matrices of each frame in flight (from its frame allocator)
+	std::vector<VkDescriptorSet> objectDescriptorSets;	// for per object data of each frame in flight (from its frame allocator, storage buffer mode only)
 
 	std::vector<VkBuffer> vpUniformBuffer;					// the raw data that descriptor will point to and describe
 	std::vector<VkDeviceMemory> vpUniformBufferMemory;
 
-	std::vector<VkBuffer> mDynamicUniformBuffer;					// the raw data that descriptor will point to and describe
-	std::vector<VkDeviceMemory> mDynamicUniformBufferMemory;
+	// view projection buffers stay mapped, a frame's copy is only rewritten when its generation is behind
+	std::vector<UboViewProjection*> mappedViewProjections;
+	std::vector<uint64_t> vpUniformGenerations;				// viewProjectionGeneration last written to each frame's buffer
+	uint64_t viewProjectionGeneration = 1;					// bumped whenever uboViewProjection changes
+	bool vpUniformMemoryCoherent = true;					// otherwise writes need a vkFlushMappedMemoryRanges
 
-	//VkDeviceSize minUniformBufferOffset;
-	//size_t modelUniformAlignment;
-	//Model* modelTransferSpace;
+	// model matrices for each frame in flight, persistently mapped and rewritten every frame
+	std::vector<VkBuffer> transformBuffer;
+	std::vector<VkDeviceMemory> transformBufferMemory;
+	std::vector<glm::mat4*> mappedTransforms;
+	uint32_t transformCapacity = 0;
 
 	// - Assets
-	std::vector<VkImage> textureImages;
-	std::vector<VkDeviceMemory> textureImageMemory;
-	std::vector<VkImageView> textureImageViews;
+	struct Texture {
+		VkDevice device = VK_NULL_HANDLE;	// the image was created on, kept once for all three handles
+		UniqueDeviceMemory memory;
+		UniqueImage image;
+		UniqueImageView imageView;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;		// sampler set it's drawn with (owned by textureDescriptorAllocator)
+		uint32_t meshCount = 0;				// meshes drawn with it, destroyed when the last one is removed
+
+		Texture() {}
+		Texture(Texture&&) = default;
+		Texture& operator=(Texture&&) = default;
+
+		// only what destroyTexture() didn't hand to the deletion queue (e.g. creating it threw halfway)
+		~Texture()
+		{
+			imageView.reset(device);
+			image.reset(device);
+			memory.reset(device);
+		}
+	};
+	SlotMap<Texture> textures;
 
 	// - Pipeline
-	VkPipeline graphicsPipeline;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;	// shared by every pipeline, persisted in PIPELINE_CACHE_FILE between runs
+	PipelineRegistry pipelineRegistry;
+	PipelineKey defaultPipelineKey = 0;
+	VkPipeline graphicsPipeline;							// default pipeline (owned by the registry)
 	VkPipelineLayout pipelineLayout;
 	VkRenderPass renderPass;
 
@@ -108,9 +324,10 @@ private:
 
 
 	// - Synchronization
-	std::vector<VkSemaphore> imageAvailable;
-	std::vector<VkSemaphore> renderFinished;
-	std::vector<VkFence> drawFences;
+	std::vector<VkSemaphore> imageAvailable;		// one per frame in flight, the render finished semaphores are per swapchain image
+	QueueTimeline graphicsTimeline;					// signalled by every graphics queue submission
+	std::vector<uint64_t> frameTimelineValues;		// value of each frame's last submission
+	DeletionQueue deletionQueue;					// resources dropped at runtime, destroyed once the timeline passed their last use
 
 	// Vulkan functions
 	// - create functions
@@ -118,6 +335,7 @@ private:
 	void createLogicalDevice();
 	void createSurface();
 	void createSwapChain();
+	void createPipelineCache();
 	void createRenderPass();
 	void createDescriptorSetLayout();
 	void createPushConstantRange();
@@ -129,26 +347,59 @@ private:
 	void createSynchronization();
 	void createTextureSampler();
 
+	void createTextureDescriptorAllocator();
+	void createFrameResources();			// everything there is one of per frame in flight
 	void createUniformBuffers();
-	void createDescriptorPool();
-	void createDescriptorSets();
+	void createFrameAllocators();
+	void createTransformBuffers(uint32_t capacity);
+	void createFrameDescriptorAllocators();
+	void writeFrameDescriptorSets();
 
-	void updateUniformBuffers(uint32_t imageIndex);
+	void updateUniformBuffers();
+	void updateTransformBuffer();
+
+	// - scene functions
+	SharedMeshBuffers& addMeshBuffers(MeshBuffers&& buffers);		// the renderer owns them from here on
+	MeshHandle addMesh(SharedMeshBuffers& shared, TextureHandle texture, const glm::mat4& model);
+
+	// - recreate functions
+	void recreateSwapChain();
+
+	// - destroy functions
+	void destroyFrameResources();
+	void destroySwapChain();
+	void destroyTransformBuffers();
+	void destroyFrameAllocators();
+	void destroyTexture(TextureHandle texture);
 
 	// - record functions
-	void recordCommands(uint32_t currentImage);
+	void recordCommands();
+	void recordRenderPass(uint32_t imageIndex);
 
 	// - get functions
 	void getPhysicalDevice();
 
-	// - allocate functions
-	//void allocateDynamicBufferTransferSpace();
+	// - select functions
+	int selectLod(Mesh& mesh, const glm::mat4& model);
+
+	// - render functions
+	bool submitRenderCommand(const RenderCommand& command);		// queue it in render thread mode, apply it at once otherwise (false if the render thread failed)
+	void applyRenderCommand(const RenderCommand& command);
+	void renderThreadLoop();
+	void drawFrame();
+
+	// - callback functions
+	static void windowRefreshCallback(GLFWwindow* refreshedWindow);
+
+	// - measure functions
+	void measureFrameLatency(uint64_t completedValue);
 
 	// - support functions
 	// -- checker functions
 	bool checkInstanceExtensionSupport(std::vector<const char*>* checkExtensions);
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 	bool checkDeviceSuitable(VkPhysicalDevice device);
+	bool checkGraphicsPipelineLibrarySupport(VkPhysicalDevice device);
 
 	// -- getter functions
 	QueueFamilyIndices getQueueFamilies(VkPhysicalDevice device);
@@ -157,17 +408,18 @@ private:
 	// -- choose functions
 	VkSurfaceFormatKHR chooseBestSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
 	VkPresentModeKHR chooseBestPresentationMode(const std::vector<VkPresentModeKHR> presentationModes);
+	uint32_t chooseSwapImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
 	VkFormat chooseSupportedFormat(const std::vector<VkFormat> &formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags);
 
 	// -- create functions
-	VkImage createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory *imageMemory);
+	VkImage createImage(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arrayLayers, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory *imageMemory);
 	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-	VkShaderModule createShaderModule(const std::vector<char>& code);
 
-	int createTextureImage(std::string fileName);
-	int createTexture(std::string fileName);
-	int createTextureDescriptor(VkImageView textureImage);
+	VkImage createTextureImage(const unsigned char* pixels, int width, int height, UploadBatch& uploadBatch, VkDeviceMemory* imageMemory);
+	std::vector<TextureHandle> createTextures(const std::vector<std::string>& fileNames);		// one upload for all of them
+	TextureHandle createTexture(const unsigned char* pixels, int width, int height, UploadBatch& uploadBatch);
+	VkDescriptorSet createTextureDescriptor(VkImageView textureImage);
 
 	// -- loader functions
 	stbi_uc* loadTextureFile(std::string fileName, int* width, int* height, VkDeviceSize* imageSize);
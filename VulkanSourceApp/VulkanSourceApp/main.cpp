@@ -8,6 +8,7 @@
 #include <vector>
 #include <iostream>
 
+#include "FrameLimiter.h"
 #include "VulkanRenderer.h"
 
 GLFWwindow* window;
@@ -25,18 +26,91 @@ void initWindow(std::string wName = "Test Window", const int width = 800, const
 	window = glfwCreateWindow(width, height, wName.c_str(), nullptr, nullptr);
 }
 
-int main()
+// frame time of each object data mode at growing object counts (run with --benchmark)
+// objects are small instances of the first mesh, so only draws and per object data grow
+static void runObjectDataBenchmark()
+{
+	const uint32_t objectCounts[] = { 1000, 10000, 100000 };
+	const ObjectDataMode modes[] = { OBJECT_DATA_PUSH_CONSTANTS, OBJECT_DATA_DYNAMIC_UNIFORM_BUFFER, OBJECT_DATA_STORAGE_BUFFER };
+	const char* modeNames[] = { "push constants", "dynamic uniform buffer", "storage buffer" };
+	const int warmupFrames = 20;
+	const int measuredFrames = 200;
+	const uint32_t gridSize = 320;		// objects per row, 320 * 320 > 100000
+	const MeshHandle quad = vulkanRenderer.getMeshHandle(0);
+
+	for (uint32_t objectCount : objectCounts)
+	{
+		// grid in front of the camera
+		while (vulkanRenderer.getModelCount() < objectCount)
+		{
+			uint32_t i = vulkanRenderer.getModelCount();
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f + (i % gridSize) * 2.0f / gridSize, -1.0f + (i / gridSize) * 2.0f / gridSize, -3.0f));
+			model = glm::scale(model, glm::vec3(1.0f / gridSize));
+			vulkanRenderer.addMeshInstance(quad, model);
+		}
+
+		for (size_t m = 0; m < 3; m++)
+		{
+			vulkanRenderer.setObjectDataMode(modes[m]);
+
+			std::chrono::steady_clock::time_point start;
+			for (int frame = 0; frame < warmupFrames + measuredFrames; frame++)
+			{
+				if (frame == warmupFrames)
+				{
+					start = std::chrono::steady_clock::now();
+				}
+
+				glfwPollEvents();
+				vulkanRenderer.requestRedraw();		// nothing moves, draw anyway
+				vulkanRenderer.draw();
+			}
+
+			double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / measuredFrames;
+			printf("%6u objects, %-22s : %.3f ms per frame\n", objectCount, modeNames[m], frameTime);
+		}
+	}
+}
+
+int main(int argc, char** argv)
 {
 	
 	//create window
 	initWindow("Test Window", 800, 600);
 
+	// mailbox/immediate with 1 frame in flight, the frame limiter below caps it at the display's refresh rate
+	vulkanRenderer.setPresentPolicy(PRESENT_POLICY_LOW_LATENCY);
+
 	//create Vulkan Renderer instance
 	if (vulkanRenderer.init(window) == EXIT_FAILURE) 
 	{
 		return EXIT_FAILURE;
 	}
 
+	// compare the per object data paths instead of running the scene
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+	{
+		runObjectDataBenchmark();
+
+		vulkanRenderer.cleanup();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return 0;
+	}
+
+	// the two meshes init() created, handles stay valid however meshes are added or removed later
+	const MeshHandle meshHandles[] = { vulkanRenderer.getMeshHandle(0), vulkanRenderer.getMeshHandle(1) };
+
+	// frames are drawn on the render thread from here on, this loop only simulates
+	vulkanRenderer.startRenderThread();
+
+	FrameLimiter frameLimiter;
+	const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	frameLimiter.setTargetFrameRate(videoMode ? videoMode->refreshRate : 60);
+
+	int frameCount = 0;
+	float lastReportTime = 0.0f;
+
 	float angle = 0.0f;
 	float deltaTime = 0.0f;
 	float lastTime = 0.0f;
@@ -44,7 +118,12 @@ int main()
 	//loop until closed
 	while (!glfwWindowShouldClose(window))
 	{
-		glfwPollEvents();
+		// sleep before sampling input, not after drawing, so the frame is built from the newest input
+		frameLimiter.wait();
+
+		// blocks instead while the last frame was skipped (nothing changed), so a static scene costs next to nothing
+		vulkanRenderer.pollEvents();
+		vulkanRenderer.beginFrame();
 
 		float now = glfwGetTime();
 		deltaTime = now - lastTime;
@@ -62,12 +141,29 @@ int main()
 		secondModel = glm::translate(secondModel, glm::vec3(0.0f, 0.0f, -2.5f));
 		secondModel = glm::rotate(secondModel, glm::radians(-angle * 100), glm::vec3(0.0f, 0.0f, 1.0f));
 
-		vulkanRenderer.updateModel(0, firstModel);
-		vulkanRenderer.updateModel(1, secondModel);
+		// all transforms of the frame in one call
+		const glm::mat4 models[] = { firstModel, secondModel };
+		vulkanRenderer.updateModels(meshHandles, models, 2);
 
 		vulkanRenderer.draw();
+
+		// frame rate and input to rendered latency once a second
+		if (!vulkanRenderer.isIdle())
+		{
+			frameCount++;
+		}
+		if (now - lastReportTime >= 1.0f)
+		{
+			JobSystemStats jobStats = vulkanRenderer.getJobStats();
+			double stealRate = jobStats.stealAttempts > 0 ? 100.0 * jobStats.steals / jobStats.stealAttempts : 0.0;
+			printf("%d fps, %.2f ms latency, %llu jobs (%.0f%% steal rate, %.0f ms worker idle)\n", frameCount, vulkanRenderer.getFrameLatency(),
+				static_cast<unsigned long long>(jobStats.jobsRun), stealRate, jobStats.idleSeconds * 1000.0);
+			frameCount = 0;
+			lastReportTime = now;
+		}
 	}
 
+	vulkanRenderer.stopRenderThread();
 	vulkanRenderer.cleanup();
 
 	//destroy glfw window and stop glfw